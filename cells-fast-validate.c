@@ -0,0 +1,169 @@
+/*
+* This file cells-fast-validate.c is part of Cells.
+*
+* (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+*
+* Cells is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Cells is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Fast math check:
+ * cells-fast-validate file.cells [max_error] [samples]
+ *
+ * Loads a cells file and its ANNs and runs Cells_fast_math_validate on every
+ * cell. Prints the worst output deviation of each cell and of the file.
+ * Returns 1 on an error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+#include <math.h>
+#include <cells.h>
+
+#define VALIDATE_MAX_ERROR 1.0e-4
+#define VALIDATE_SAMPLES 1000
+
+S8 cells_number (U1 *filename)
+{
+	// the header of the file has the line: "cells = N"
+	FILE *fptr;
+	char buf[256];
+	S8 max_cells = 0;
+
+	fptr = fopen ((const char *) filename, "r");
+	if (fptr == NULL)
+	{
+		return (0);
+	}
+	while (fgets (buf, sizeof (buf), fptr) != NULL)
+	{
+		if (sscanf (buf, "cells = %lli", &max_cells) == 1)
+		{
+			break;
+		}
+	}
+	fclose (fptr);
+	return (max_cells);
+}
+
+S2 read_anns (struct cell *cells, S8 max_cells, S8 *nodes)
+{
+	// the loaded nodes have no ANNs: read them from their file names
+	F8 *values;
+	S8 i, n, values_max = 0;
+
+	*nodes = 0;
+	for (i = 0; i < max_cells; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (cells[i].neurons[n].inputs > values_max) values_max = cells[i].neurons[n].inputs;
+			if (cells[i].neurons[n].outputs > values_max) values_max = cells[i].neurons[n].outputs;
+		}
+	}
+
+	values = (F8 *) calloc (values_max + 1, sizeof (F8));
+	if (values == NULL)
+	{
+		printf ("ERROR: can't allocate node values!\n");
+		return (1);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (cells[i].neurons[n].type != ANN)
+			{
+				continue;
+			}
+			if (Cells_fann_read_ann (cells, i, n, (U1 *) "", 0, 0, values, values, cells[i].neurons[n].layer, 0) != 0)
+			{
+				printf ("ERROR: can't read ANN: cell: %lli, node: %lli!\n", i, n);
+				free (values);
+				return (1);
+			}
+			(*nodes)++;
+		}
+	}
+	free (values);
+	return (0);
+}
+
+int main (int ac, char *av[])
+{
+	struct cell *cells;
+	F8 max_error = VALIDATE_MAX_ERROR;
+	F8 deviation, worst = 0.0;
+	S8 samples = VALIDATE_SAMPLES;
+	S8 max_cells, nodes, i, worst_cell = 0;
+
+	if (ac < 2 || ac > 4)
+	{
+		printf ("cells-fast-validate file.cells [max_error] [samples]\n");
+		exit (1);
+	}
+	if (ac > 2) max_error = strtod (av[2], NULL);
+	if (ac > 3) samples = strtoll (av[3], NULL, 10);
+	if (samples < 1)
+	{
+		printf ("ERROR: samples must be at least 1!\n");
+		exit (1);
+	}
+
+	max_cells = cells_number ((U1 *) av[1]);
+	if (max_cells < 1)
+	{
+		printf ("ERROR: can't read cells number of file: '%s'!\n", av[1]);
+		exit (1);
+	}
+
+	cells = Cells_fann_load_cells ((U1 *) av[1]);
+	if (cells == NULL)
+	{
+		printf ("ERROR: can't load cells file: '%s'!\n", av[1]);
+		exit (1);
+	}
+
+	if (read_anns (cells, max_cells, &nodes) != 0)
+	{
+		Cells_dealloc_neurons (cells, max_cells);
+		free (cells);
+		exit (1);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		if (Cells_fast_math_validate (cells, i, i, max_error, samples, &deviation) != 0)
+		{
+			Cells_dealloc_neurons (cells, max_cells);
+			free (cells);
+			exit (1);
+		}
+		printf ("cell %lli: worst deviation %e\n", i, deviation);
+		if (deviation > worst)
+		{
+			worst = deviation;
+			worst_cell = i;
+		}
+	}
+
+	printf ("%s: %lli cells, %lli ANN nodes, max error %e, %lli samples: worst deviation %e in cell %lli\n", av[1], max_cells, nodes, max_error, samples, worst, worst_cell);
+
+	Cells_dealloc_neurons (cells, max_cells);
+	free (cells);
+	exit (0);
+}
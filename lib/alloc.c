@@ -0,0 +1,467 @@
+/*
+ * This file alloc.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Memory allocation:
+ * All memory of the Cells library is allocated by the functions here.
+ *
+ * The allocation guard is a test hook: after Cells_alloc_guard (TRUE) every
+ * allocation fails with an error message and is counted, until the guard is
+ * switched off again. Set it around the runs of an initialised graph, if the
+ * run returns an error or Cells_alloc_guard_count () is not zero, the run did
+ * allocate memory.
+ *
+ * Arena:
+ * Cells_alloc_cells_arena allocates the cells array and the nodes in one
+ * arena, and all cells point to it. Then all node inputs/outputs buffers and
+ * links of these cells are taken from the arena too, one after the other in
+ * big chunks. Nothing is freed on its own, Cells_dealloc_cells_arena frees
+ * the whole arena at once. The compiled plans are not in the arena, they are
+ * compiled again on every topology change.
+ *
+ * Slab:
+ * One block of memory for the weights of all kernels of a graph, see slab.c.
+ * It is taken from huge pages if asked for: first mmap with MAP_HUGETLB,
+ * which needs reserved huge pages, then memory aligned to a huge page with
+ * madvise MADV_HUGEPAGE for transparent huge pages. Else it is cache line
+ * aligned memory with normal pages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#include "cells-internal.h"
+
+#define ARENA_CHUNK 65536		// default chunk size
+#define ARENA_ALIGN 16
+#define SLAB_HUGE_PAGE 2097152	// 2 MB
+
+struct arena_chunk
+{
+	struct arena_chunk *next;
+	S8 size;
+	S8 used;
+} __attribute__ ((aligned (CELLS_ALIGN)));
+
+struct arena
+{
+	struct arena_chunk *chunks;		// current chunk first
+	S8 chunk_size;
+	S8 bytes;						// allocated by the arena users
+};
+
+struct slab
+{
+	U1 *memory;
+	S8 size;
+	S8 used;
+	U1 pages;						// SLAB_PAGES, SLAB_HUGETLB or SLAB_THP
+	struct slab *older;				// slab still used by some kernels, freed with this one
+};
+
+static atomic_int alloc_guard = 0;
+static atomic_llong alloc_guard_count = 0;
+
+S2 Cells_alloc_guard (U1 on)
+{
+	if (on == TRUE)
+	{
+		atomic_store (&alloc_guard_count, 0);
+	}
+	atomic_store (&alloc_guard, on == TRUE);
+	return (0);
+}
+
+S8 Cells_alloc_guard_count (void)
+{
+	return (atomic_load (&alloc_guard_count));
+}
+
+static S2 alloc_guard_check (S8 size)
+{
+	if (atomic_load (&alloc_guard) != 0)
+	{
+		atomic_fetch_add (&alloc_guard_count, 1);
+		printf ("alloc guard: ERROR: allocation of %lli bytes while guard is set!\n", size);
+		return (1);
+	}
+	return (0);
+}
+
+void *cells_calloc (S8 n, S8 size)
+{
+	if (alloc_guard_check (n * size) != 0)
+	{
+		return (NULL);
+	}
+	return (calloc (n, size));
+}
+
+void *cells_aligned_alloc (S8 size)
+{
+	// cache line aligned memory, set to zero
+	void *ptr;
+
+	if (alloc_guard_check (size) != 0)
+	{
+		return (NULL);
+	}
+
+	if (size <= 0)
+	{
+		size = 1;
+	}
+	size = (size + CELLS_ALIGN - 1) & ~((S8) CELLS_ALIGN - 1);
+
+	if (posix_memalign (&ptr, CELLS_ALIGN, size) != 0)
+	{
+		return (NULL);
+	}
+	memset (ptr, 0, size);
+	return (ptr);
+}
+
+void cells_free (void *ptr)
+{
+	free (ptr);
+}
+
+
+// arena:
+
+struct arena *arena_create (S8 reserve)
+{
+	struct arena *arena;
+
+	if (alloc_guard_check (sizeof (struct arena)) != 0)
+	{
+		return (NULL);
+	}
+
+	arena = (struct arena *) calloc (1, sizeof (struct arena));
+	if (arena == NULL)
+	{
+		return (NULL);
+	}
+
+	arena->chunk_size = reserve > 0 ? reserve : ARENA_CHUNK;
+	return (arena);
+}
+
+void *arena_alloc (struct arena *arena, S8 size, S8 align)
+{
+	// memory set to zero, align must be a power of two up to CELLS_ALIGN
+	struct arena_chunk *chunk;
+	S8 start, chunk_size;
+
+	if (size <= 0)
+	{
+		size = 1;
+	}
+
+	chunk = arena->chunks;
+	if (chunk != NULL)
+	{
+		start = (chunk->used + align - 1) & ~(align - 1);
+		if (start + size <= chunk->size)
+		{
+			chunk->used = start + size;
+			arena->bytes += size;
+			return ((U1 *) (chunk + 1) + start);
+		}
+	}
+
+	// new chunk, doubled in size
+	chunk_size = arena->chunk_size;
+	if (arena->chunks != NULL)
+	{
+		chunk_size = arena->chunks->size * 2;
+	}
+	if (chunk_size < size)
+	{
+		chunk_size = size;
+	}
+
+	if (alloc_guard_check (chunk_size) != 0)
+	{
+		return (NULL);
+	}
+	if (posix_memalign ((void **) &chunk, CELLS_ALIGN, sizeof (struct arena_chunk) + chunk_size) != 0)
+	{
+		return (NULL);
+	}
+	memset (chunk, 0, sizeof (struct arena_chunk) + chunk_size);
+
+	chunk->size = chunk_size;
+	chunk->used = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->bytes += size;
+	return (chunk + 1);
+}
+
+void arena_free (struct arena *arena)
+{
+	struct arena_chunk *chunk;
+	struct arena_chunk *next;
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = next)
+	{
+		next = chunk->next;
+		free (chunk);
+	}
+	free (arena);
+}
+
+S8 arena_bytes (struct arena *arena)
+{
+	return (arena->bytes);
+}
+
+void *cell_calloc (struct cell *cells, S8 cell, S8 n, S8 size)
+{
+	// node memory: from the arena of the cell, if it has one
+	if (cells[cell].arena != NULL)
+	{
+		return (arena_alloc (cells[cell].arena, n * size, ARENA_ALIGN));
+	}
+	return (cells_calloc (n, size));
+}
+
+void *cell_aligned_alloc (struct cell *cells, S8 cell, S8 size)
+{
+	if (cells[cell].arena != NULL)
+	{
+		return (arena_alloc (cells[cell].arena, size, CELLS_ALIGN));
+	}
+	return (cells_aligned_alloc (size));
+}
+
+void cell_free (struct cell *cells, S8 cell, void *ptr)
+{
+	// arena memory is only freed with the whole arena
+	if (cells[cell].arena == NULL)
+	{
+		cells_free (ptr);
+	}
+}
+
+struct cell *Cells_alloc_cells_arena (S8 max_cells, S8 neurons, S8 reserve)
+{
+	// allocate cells and nodes in a new arena, reserve: first chunk size in bytes, 0 = default
+	struct arena *arena;
+	struct cell *cells;
+	S8 i;
+
+	arena = arena_create (reserve);
+	if (arena == NULL)
+	{
+		printf ("alloc_cells_arena: ERROR: can't allocate arena!\n");
+		return (NULL);
+	}
+
+	cells = (struct cell *) arena_alloc (arena, max_cells * sizeof (struct cell), CELLS_ALIGN);
+	if (cells == NULL)
+	{
+		printf ("alloc_cells_arena: ERROR: can't allocate %lli cells!\n", max_cells);
+		arena_free (arena);
+		return (NULL);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		cells[i].arena = arena;
+	}
+
+	if (neurons > 0)
+	{
+		if (Cells_alloc_neurons_equal (cells, max_cells, neurons) != 0)
+		{
+			arena_free (arena);
+			return (NULL);
+		}
+	}
+	return (cells);
+}
+
+S2 Cells_dealloc_cells_arena (struct cell *cells, S8 max_cells)
+{
+	// free cells of an arena: only the ANNs, caches, kernels and plans are freed on their own
+	struct arena *arena;
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("dealloc_cells_arena: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	arena = cells[0].arena;
+	if (arena == NULL)
+	{
+		printf ("dealloc_cells_arena: ERROR: cells have no arena!\n");
+		return (1);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (cells[i].neurons[n].fann_state == ANNOPEN) fann_destroy (cells[i].neurons[n].ann);
+			if (cells[i].neurons[n].memo) memo_free (cells[i].neurons[n].memo);
+			if (cells[i].neurons[n].kernel) kernel_free (cells[i].neurons[n].kernel);
+		}
+		plan_free (cells, i);
+		if (cells[i].fast) fast_free (cells[i].fast);
+		if (cells[i].bind) bind_free (cells[i].bind);
+	}
+	if (max_cells > 0 && cells[0].names) names_free (cells[0].names);
+	if (max_cells > 0 && cells[0].slab) slab_free (cells[0].slab);
+
+	arena_free (arena);
+	return (0);
+}
+
+S8 Cells_arena_bytes (struct cell *cells)
+{
+	if (cells == NULL || cells[0].arena == NULL)
+	{
+		return (0);
+	}
+	return (arena_bytes (cells[0].arena));
+}
+
+
+// slab:
+
+struct slab *slab_create (S8 size, U1 huge)
+{
+	// memory set to zero, huge: TRUE = try huge pages
+	struct slab *slab;
+	void *ptr;
+	S8 huge_size;
+
+	if (alloc_guard_check (size) != 0)
+	{
+		return (NULL);
+	}
+
+	slab = (struct slab *) calloc (1, sizeof (struct slab));
+	if (slab == NULL)
+	{
+		return (NULL);
+	}
+
+	if (size <= 0)
+	{
+		size = 1;
+	}
+	size = (size + CELLS_ALIGN - 1) & ~((S8) CELLS_ALIGN - 1);
+	huge_size = (size + SLAB_HUGE_PAGE - 1) & ~((S8) SLAB_HUGE_PAGE - 1);
+
+#ifdef MAP_HUGETLB
+	if (huge == TRUE)
+	{
+		// anonymous mapping: set to zero
+		ptr = mmap (NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			slab->memory = (U1 *) ptr;
+			slab->size = huge_size;
+			slab->pages = SLAB_HUGETLB;
+			return (slab);
+		}
+	}
+#endif
+
+	if (posix_memalign (&ptr, huge == TRUE ? SLAB_HUGE_PAGE : CELLS_ALIGN, huge == TRUE ? huge_size : size) != 0)
+	{
+		free (slab);
+		return (NULL);
+	}
+	slab->memory = (U1 *) ptr;
+	slab->size = huge == TRUE ? huge_size : size;
+	slab->pages = SLAB_PAGES;
+
+#ifdef MADV_HUGEPAGE
+	if (huge == TRUE && madvise (ptr, slab->size, MADV_HUGEPAGE) == 0)
+	{
+		slab->pages = SLAB_THP;
+	}
+#endif
+
+	memset (slab->memory, 0, slab->size);
+	return (slab);
+}
+
+void *slab_alloc (struct slab *slab, S8 size)
+{
+	// cache line aligned, NULL = slab full
+	U1 *ptr;
+
+	size = (size + CELLS_ALIGN - 1) & ~((S8) CELLS_ALIGN - 1);
+	if (slab->used + size > slab->size)
+	{
+		return (NULL);
+	}
+
+	ptr = slab->memory + slab->used;
+	slab->used += size;
+	return (ptr);
+}
+
+void slab_free (struct slab *slab)
+{
+	struct slab *older;
+
+	for (; slab != NULL; slab = older)
+	{
+		older = slab->older;
+		if (slab->pages == SLAB_HUGETLB)
+		{
+			munmap (slab->memory, slab->size);
+		}
+		else
+		{
+			free (slab->memory);
+		}
+		free (slab);
+	}
+}
+
+void slab_keep (struct slab *slab, struct slab *older)
+{
+	// older is freed with slab
+	slab->older = older;
+}
+
+S8 slab_bytes (struct slab *slab)
+{
+	return (slab->used);
+}
+
+U1 slab_pages (struct slab *slab)
+{
+	return (slab->pages);
+}
@@ -0,0 +1,257 @@
+/*
+ * This file batch.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Batch run:
+ * Cells_run_batch runs "batch" input vectors through all layers of a cell in
+ * one call. Every node runs its ANN on all vectors of the batch before the
+ * next node of the plan is run, and the links copy the whole batch.
+ *
+ * inputs [i] is the input matrix of the node input_nodes [i]: batch rows of
+ * the node inputs. outputs [o] gets the output matrix of output_nodes [o]:
+ * batch rows of the node outputs. Node inputs which are not set by a link or
+ * by an input matrix get the current inputs of the node for every row: the
+ * bound inputs buffer, if Cells_bind_inputs was used.
+ *
+ * A batch run doesn't use fused chains, groups or link aliases: every node
+ * runs its own kernel on the batch, and every link is copied one by one.
+ *
+ * The batch buffers are kept in the cell plan and are only allocated again
+ * for a bigger batch. The inputs and outputs of the nodes are not changed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+
+void batch_free (struct plan_batch *batch)
+{
+	if (batch->inputs_start) cells_free (batch->inputs_start);
+	if (batch->outputs_start) cells_free (batch->outputs_start);
+	if (batch->buffer) cells_free (batch->buffer);
+	cells_free (batch);
+}
+
+static S2 batch_alloc (struct cell *cells, S8 cell, S8 batch_max)
+{
+	struct plan *plan;
+	struct plan_batch *batch;
+	struct neuron *neuron;
+	S8 e, size = 0;
+
+	plan = cells[cell].plan;
+	if (plan->batch != NULL && plan->batch->batch_max >= batch_max)
+	{
+		return (0);
+	}
+
+	batch = (struct plan_batch *) cells_calloc (1, sizeof (struct plan_batch));
+	if (batch == NULL)
+	{
+		printf ("run_batch: out of memory, allocating batch!\n");
+		return (1);
+	}
+
+	batch->inputs_start = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	batch->outputs_start = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	if (batch->inputs_start == NULL || batch->outputs_start == NULL)
+	{
+		printf ("run_batch: out of memory, allocating batch entries!\n");
+		batch_free (batch);
+		return (1);
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		neuron = &cells[cell].neurons[plan->entries[e].node];
+
+		batch->inputs_start[e] = size;
+		size += neuron->inputs * batch_max;
+		batch->outputs_start[e] = size;
+		size += neuron->outputs * batch_max;
+	}
+
+	batch->buffer = (fann_type *) cells_calloc (size + 1, sizeof (fann_type));
+	if (batch->buffer == NULL)
+	{
+		printf ("run_batch: out of memory, allocating batch buffer!\n");
+		batch_free (batch);
+		return (1);
+	}
+	batch->batch_max = batch_max;
+
+	if (plan->batch) batch_free (plan->batch);
+	plan->batch = batch;
+	return (0);
+}
+
+static S2 batch_check_node (struct cell *cells, S8 cell, S8 node)
+{
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("run_batch: error: node out of range: %lli!\n", node);
+		return (1);
+	}
+
+	if (cells[cell].plan->node_entry[node] < 0)
+	{
+		printf ("run_batch: error: node has no ANN: %lli!\n", node);
+		return (1);
+	}
+	return (0);
+}
+
+S2 Cells_run_batch (struct cell *cells, S8 cell, S8 batch, S8 inputs_max, S8 *input_nodes, F8 **inputs, S8 outputs_max, S8 *output_nodes, F8 **outputs)
+{
+	struct plan *plan;
+	struct plan_entry *entry;
+	struct plan_batch *buffers;
+	struct plan_link *link;
+	struct neuron *neurons;
+	struct neuron *neuron;
+	fann_type *input_f;
+	fann_type *output_f;
+	fann_type *run_f;
+	S8 e, i, j, b, n;
+	S8 dest_inputs, inputs_e, outputs_e;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_batch: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (batch <= 0)
+	{
+		printf ("run_batch: error: batch size must be greater than zero!\n");
+		return (1);
+	}
+
+	if (plan_check (cells, cell) != 0)
+	{
+		printf ("run_batch: error compiling cell: %lli!\n", cell);
+		return (1);
+	}
+
+	for (i = 0; i < inputs_max; i++)
+	{
+		if (batch_check_node (cells, cell, input_nodes[i]) != 0)
+		{
+			return (1);
+		}
+	}
+	for (i = 0; i < outputs_max; i++)
+	{
+		if (batch_check_node (cells, cell, output_nodes[i]) != 0)
+		{
+			return (1);
+		}
+	}
+
+	if (batch_alloc (cells, cell, batch) != 0)
+	{
+		return (1);
+	}
+
+	plan = cells[cell].plan;
+	buffers = plan->batch;
+	neurons = cells[cell].neurons;
+
+	// set the batch inputs: the current node inputs for every row, from the bound buffers if set...
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		inputs_e = plan->inputs[e];
+		input_f = &buffers->buffer[buffers->inputs_start[e]];
+
+		for (b = 0; b < batch; b++)
+		{
+			if (plan->storage == STORAGE_FANN)
+			{
+				memcpy (&input_f[b * inputs_e], plan->inputs_f[e], inputs_e * sizeof (fann_type));
+				continue;
+			}
+			for (n = 0; n < inputs_e; n++)
+			{
+				input_f[b * inputs_e + n] = plan->inputs_nodef[e][n];
+			}
+		}
+	}
+
+	// ... and the input matrices
+	for (i = 0; i < inputs_max; i++)
+	{
+		e = plan->node_entry[input_nodes[i]];
+		neuron = &neurons[input_nodes[i]];
+		input_f = &buffers->buffer[buffers->inputs_start[e]];
+
+		for (n = 0; n < batch * neuron->inputs; n++)
+		{
+			input_f[n] = inputs[i][n];
+		}
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		entry = &plan->entries[e];
+		inputs_e = plan->inputs[e];
+		outputs_e = plan->outputs[e];
+		input_f = &buffers->buffer[buffers->inputs_start[e]];
+		output_f = &buffers->buffer[buffers->outputs_start[e]];
+
+		// whole batch on this ANN
+		for (b = 0; b < batch; b++)
+		{
+			run_f = kernel_run (plan->kernel[e], plan->ann[e], &input_f[b * inputs_e]);
+			for (n = 0; n < outputs_e; n++)
+			{
+				output_f[b * outputs_e + n] = run_f[n];
+			}
+		}
+
+		for (j = entry->link_start; j < entry->link_end; j++)
+		{
+			link = &plan->links[j];
+			dest_inputs = plan->inputs[link->node];
+			input_f = &buffers->buffer[buffers->inputs_start[link->node]];
+
+			for (b = 0; b < batch; b++)
+			{
+				input_f[b * dest_inputs + link->node_input] = output_f[b * outputs_e + link->node_output];
+			}
+		}
+	}
+
+	for (i = 0; i < outputs_max; i++)
+	{
+		e = plan->node_entry[output_nodes[i]];
+		neuron = &neurons[output_nodes[i]];
+		output_f = &buffers->buffer[buffers->outputs_start[e]];
+
+		for (n = 0; n < batch * neuron->outputs; n++)
+		{
+			outputs[i][n] = output_f[n];
+		}
+	}
+	return (0);
+}
@@ -0,0 +1,416 @@
+/*
+ * This file bind.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Bound input/output buffers:
+ * Cells_bind_inputs (cells, cell, nodes_max, nodes, buffer) lets the nodes of
+ * a cell read their inputs from one buffer of the caller: the inputs of the
+ * first node, then the inputs of the next node and so on.
+ * Cells_bind_outputs does the same for the outputs of nodes. The buffer has
+ * F8 values for STORAGE_F8 and fann_type values for STORAGE_FANN, the
+ * storage of the cell must not change while the buffers are bound.
+ *
+ * The compiled plan points the inputs/outputs of the bound nodes into the
+ * buffers, so the plan runs (Cells_run_plan, Cells_run_plan_dirty,
+ * Cells_run_plan_threads, Cells_run_cells_threads and Cells_run_targets)
+ * read and write them directly: a run needs no Cells_fann_do_update_ann and
+ * no Cells_fann_get_output calls. Links to a bound node write into the
+ * buffer. The own buffers of the bound nodes are not used by the plan runs.
+ * Cells_fann_run_ann_go_links runs the nodes in their own buffers: it copies
+ * the bound inputs in before and the outputs out to the buffer after a node
+ * runs, and its links to a bound node write into the buffer too.
+ *
+ * Cells_fann_get_output and the values of Cells_run_targets read a bound
+ * output from the buffer, Cells_fann_do_update_ann writes the inputs of a
+ * bound node to the buffer and to the own buffers of the node. Cells_run_batch takes the
+ * inputs which are not in its input matrices from the bound buffer.
+ *
+ * The buffers must stay allocated until they are bound again, or a binding
+ * with no nodes removes them. Bind them again if the bound nodes are read
+ * again with other sizes. Cells_run_plan_dirty doesn't know if the
+ * caller changed the inputs: mark the nodes dirty with
+ * Cells_fann_do_update_ann or use Cells_run_plan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+#define BIND_INPUTS 0
+#define BIND_OUTPUTS 1
+
+struct bind_buffer
+{
+	S8 nodes_max;
+	S8 *nodes;
+	S8 *start;				// per node: first value in the buffer
+	void *buffer;
+};
+
+struct bind
+{
+	U1 storage;				// storage of the buffers
+	struct bind_buffer buffers[2];	// BIND_INPUTS and BIND_OUTPUTS
+};
+
+static void bind_buffer_free (struct bind_buffer *buffer)
+{
+	if (buffer->nodes) cells_free (buffer->nodes);
+	if (buffer->start) cells_free (buffer->start);
+	memset (buffer, 0, sizeof (struct bind_buffer));
+}
+
+void bind_free (struct bind *bind)
+{
+	bind_buffer_free (&bind->buffers[BIND_INPUTS]);
+	bind_buffer_free (&bind->buffers[BIND_OUTPUTS]);
+	cells_free (bind);
+}
+
+S2 bind_plan (struct cell *cells, S8 cell, struct plan *plan)
+{
+	// point the inputs/outputs of the bound plan entries into the buffers
+	struct bind *bind;
+	struct bind_buffer *buffer;
+	S8 b, k, e;
+
+	bind = cells[cell].bind;
+	if (bind == NULL)
+	{
+		return (0);
+	}
+
+	if (bind->storage != plan->storage)
+	{
+		printf ("compile_plan: error: bound buffers have another storage: cell: %lli!\n", cell);
+		return (1);
+	}
+
+	for (b = BIND_INPUTS; b <= BIND_OUTPUTS; b++)
+	{
+		buffer = &bind->buffers[b];
+		for (k = 0; k < buffer->nodes_max; k++)
+		{
+			if (buffer->nodes[k] >= cells[cell].neurons_max || plan->node_entry[buffer->nodes[k]] < 0)
+			{
+				printf ("compile_plan: error: bound node has no ANN: cell: %lli, node: %lli!\n", cell, buffer->nodes[k]);
+				return (1);
+			}
+
+			e = plan->node_entry[buffer->nodes[k]];
+			if (plan->storage == STORAGE_FANN)
+			{
+				if (b == BIND_INPUTS) plan->inputs_f[e] = (fann_type *) buffer->buffer + buffer->start[k];
+				else plan->outputs_f[e] = (fann_type *) buffer->buffer + buffer->start[k];
+			}
+			else
+			{
+				// STORAGE_F8: inputs_f stays the staging buffer of the node
+				if (b == BIND_INPUTS) plan->inputs_nodef[e] = (F8 *) buffer->buffer + buffer->start[k];
+				else plan->outputs_nodef[e] = (F8 *) buffer->buffer + buffer->start[k];
+			}
+		}
+	}
+	return (0);
+}
+
+static S8 bind_find (struct bind_buffer *buffer, S8 node)
+{
+	// index of a bound node, the last one if it's bound twice as in bind_plan, -1 = not bound
+	S8 k;
+
+	for (k = buffer->nodes_max - 1; k >= 0; k--)
+	{
+		if (buffer->nodes[k] == node)
+		{
+			return (k);
+		}
+	}
+	return (-1);
+}
+
+U1 bind_get_output (struct cell *cells, S8 cell, S8 node, S8 output, F8 *value)
+{
+	// read an output of a node from the bound outputs buffer, FALSE = not bound
+	struct bind_buffer *buffer;
+	S8 k;
+
+	if (cells[cell].bind == NULL)
+	{
+		return (FALSE);
+	}
+
+	buffer = &cells[cell].bind->buffers[BIND_OUTPUTS];
+	k = bind_find (buffer, node);
+	if (k < 0)
+	{
+		return (FALSE);
+	}
+
+	if (cells[cell].bind->storage == STORAGE_FANN)
+	{
+		value[0] = ((fann_type *) buffer->buffer)[buffer->start[k] + output];
+	}
+	else
+	{
+		value[0] = ((F8 *) buffer->buffer)[buffer->start[k] + output];
+	}
+	return (TRUE);
+}
+
+void bind_set_inputs (struct cell *cells, S8 cell, S8 node, F8 *inputs)
+{
+	// write the inputs of a node to the bound inputs buffer, if the node is bound
+	struct bind_buffer *buffer;
+	S8 k, n;
+
+	if (cells[cell].bind == NULL)
+	{
+		return;
+	}
+
+	buffer = &cells[cell].bind->buffers[BIND_INPUTS];
+	k = bind_find (buffer, node);
+	if (k < 0)
+	{
+		return;
+	}
+
+	for (n = 0; n < cells[cell].neurons[node].inputs; n++)
+	{
+		if (cells[cell].bind->storage == STORAGE_FANN)
+		{
+			((fann_type *) buffer->buffer)[buffer->start[k] + n] = inputs[n];
+		}
+		else
+		{
+			((F8 *) buffer->buffer)[buffer->start[k] + n] = inputs[n];
+		}
+	}
+}
+
+void *bind_values (struct cell *cells, S8 cell, S8 node, U1 outputs)
+{
+	// the bound inputs or outputs of a node in the buffer, NULL = not bound
+	struct bind_buffer *buffer;
+	S8 k;
+
+	// buffers of another storage are not used, the plan compiler reports them
+	if (cells[cell].bind == NULL || cells[cell].bind->storage != cells[cell].storage)
+	{
+		return (NULL);
+	}
+
+	buffer = &cells[cell].bind->buffers[outputs == TRUE ? BIND_OUTPUTS : BIND_INPUTS];
+	k = bind_find (buffer, node);
+	if (k < 0)
+	{
+		return (NULL);
+	}
+
+	if (cells[cell].bind->storage == STORAGE_FANN)
+	{
+		return ((fann_type *) buffer->buffer + buffer->start[k]);
+	}
+	return ((F8 *) buffer->buffer + buffer->start[k]);
+}
+
+void bind_read_inputs (struct cell *cells, S8 cell, S8 node)
+{
+	// copy the bound inputs of a node to its own buffer
+	struct neuron *neuron;
+	void *values;
+
+	values = bind_values (cells, cell, node, FALSE);
+	if (values == NULL)
+	{
+		return;
+	}
+
+	neuron = &cells[cell].neurons[node];
+	if (cells[cell].bind->storage == STORAGE_FANN)
+	{
+		memcpy (neuron->inputs_f, values, neuron->inputs * sizeof (fann_type));
+	}
+	else
+	{
+		memcpy (neuron->inputs_nodef, values, neuron->inputs * sizeof (F8));
+	}
+}
+
+void bind_write_outputs (struct cell *cells, S8 cell, S8 node)
+{
+	// copy the outputs of a node from its own buffer to the bound buffer
+	struct neuron *neuron;
+	void *values;
+
+	values = bind_values (cells, cell, node, TRUE);
+	if (values == NULL)
+	{
+		return;
+	}
+
+	neuron = &cells[cell].neurons[node];
+	if (cells[cell].bind->storage == STORAGE_FANN)
+	{
+		memcpy (values, neuron->outputs_f, neuron->outputs * sizeof (fann_type));
+	}
+	else
+	{
+		memcpy (values, neuron->outputs_nodef, neuron->outputs * sizeof (F8));
+	}
+}
+
+static S2 bind_set (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, void *buffer, U1 b)
+{
+	struct bind *bind;
+	struct bind_buffer *bound;
+	struct neuron *neuron;
+	S8 k, start = 0;
+
+	for (k = 0; k < nodes_max; k++)
+	{
+		if (nodes[k] < 0 || nodes[k] >= cells[cell].neurons_max)
+		{
+			printf ("bind: error: node out of range: %lli!\n", nodes[k]);
+			return (1);
+		}
+
+		neuron = &cells[cell].neurons[nodes[k]];
+		if (neuron->fann_state != ANNOPEN)
+		{
+			printf ("bind: error: node has no ANN: cell: %lli, node: %lli!\n", cell, nodes[k]);
+			return (1);
+		}
+	}
+
+	bind = cells[cell].bind;
+	if (bind == NULL)
+	{
+		if (nodes_max == 0)
+		{
+			return (0);
+		}
+
+		bind = (struct bind *) cells_calloc (1, sizeof (struct bind));
+		if (bind == NULL)
+		{
+			printf ("bind: out of memory, allocating binding!\n");
+			return (1);
+		}
+		cells[cell].bind = bind;
+	}
+
+	bound = &bind->buffers[b];
+	bind_buffer_free (bound);
+	cells[cell].topology++;
+
+	if (nodes_max > 0)
+	{
+		bound->nodes = (S8 *) cells_calloc (nodes_max + 1, sizeof (S8));
+		bound->start = (S8 *) cells_calloc (nodes_max + 1, sizeof (S8));
+		if (bound->nodes == NULL || bound->start == NULL)
+		{
+			printf ("bind: out of memory, allocating bound nodes!\n");
+			bind_buffer_free (bound);
+			return (1);
+		}
+
+		for (k = 0; k < nodes_max; k++)
+		{
+			neuron = &cells[cell].neurons[nodes[k]];
+			bound->nodes[k] = nodes[k];
+			bound->start[k] = start;
+			start += b == BIND_INPUTS ? neuron->inputs : neuron->outputs;
+		}
+		bound->nodes_max = nodes_max;
+		bound->buffer = buffer;
+	}
+
+	bind->storage = cells[cell].storage;
+	if (bind->buffers[BIND_INPUTS].nodes_max == 0 && bind->buffers[BIND_OUTPUTS].nodes_max == 0)
+	{
+		bind_free (bind);
+		cells[cell].bind = NULL;
+	}
+	return (0);
+}
+
+S2 Cells_bind_inputs (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, void *buffer)
+{
+	// buffer: inputs of the nodes one after the other, F8 or fann_type as the cell storage, nodes_max 0 = unbind
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("bind_inputs: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (nodes_max > 0 && buffer == NULL)
+	{
+		printf ("bind_inputs: error: no buffer!\n");
+		return (1);
+	}
+	return (bind_set (cells, cell, nodes_max, nodes, buffer, BIND_INPUTS));
+}
+
+S2 Cells_bind_outputs (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, void *buffer)
+{
+	// buffer: outputs of the nodes one after the other, F8 or fann_type as the cell storage, nodes_max 0 = unbind
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("bind_outputs: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (nodes_max > 0 && buffer == NULL)
+	{
+		printf ("bind_outputs: error: no buffer!\n");
+		return (1);
+	}
+	return (bind_set (cells, cell, nodes_max, nodes, buffer, BIND_OUTPUTS));
+}
+
+S8 Cells_bind_size (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, U1 outputs)
+{
+	// values of a buffer for the nodes, outputs: TRUE = outputs buffer, -1 = error
+	S8 k, size = 0;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("bind_size: ERROR: cells structure not allocated!\n");
+		return (-1);
+	}
+
+	for (k = 0; k < nodes_max; k++)
+	{
+		if (nodes[k] < 0 || nodes[k] >= cells[cell].neurons_max)
+		{
+			printf ("bind_size: error: node out of range: %lli!\n", nodes[k]);
+			return (-1);
+		}
+		size += outputs == TRUE ? cells[cell].neurons[nodes[k]].outputs : cells[cell].neurons[nodes[k]].inputs;
+	}
+	return (size);
+}
@@ -0,0 +1,286 @@
+/*
+* This file cells-internal.h is part of Cells.
+*
+* (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+*
+* Cells is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Cells is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Internal structures and functions of the library, used by its .c files
+ * only. This header is not installed, programs include cells.h.
+ */
+
+#include "cells.h"
+
+
+// cold node data, not used by the runs: one entry per node in the cell
+struct neuron_cold
+{
+	S8 fann_name;			// ID in the name table, see names.c
+	U1 weights;				// weights of the native kernel: WEIGHTS_F32, WEIGHTS_F16 or WEIGHTS_BF16
+};
+
+// compiled execution plan, see plan.c
+struct plan_entry
+{
+	S8 node;
+	S8 layer;
+	S8 link_start;			// range of this node in the plan links, link node is a plan entry
+	S8 link_end;
+	S8 range_start;			// range of this node in the plan link ranges
+	S8 range_end;
+};
+
+// links merged to one copy: count inputs from count outputs
+struct plan_range
+{
+	S8 node;				// plan entry of the linked node
+	S8 input;				// first input of the linked node
+	S8 output;				// first output of this node
+	S8 count;
+};
+
+struct plan_layer
+{
+	S8 layer;
+	S8 entry_start;			// range of this layer in the plan entries
+	S8 entry_end;
+	S8 group_start;			// range of this layer in the pull groups
+	S8 group_end;
+};
+
+// range copies of one layer, sorted by the linked entry, see pool.c
+struct plan_pull
+{
+	S8 node;				// plan entry of the linked node
+	S8 entry;				// plan entry with the outputs
+	S8 range;
+};
+
+// batch run buffers, see batch.c
+struct plan_batch
+{
+	S8 batch_max;
+	S8 *inputs_start;		// per plan entry: start of the batch inputs in buffer
+	S8 *outputs_start;		// per plan entry: start of the batch outputs in buffer
+	fann_type *buffer;
+};
+
+// cached backward cone of target nodes, see demand.c
+struct plan_cone
+{
+	S8 targets_max;
+	S8 *targets;			// sorted target plan entries
+	S8 entries_max;
+	S8 *entries;			// plan entries to run, in plan order
+	struct plan_cone *next;
+};
+
+// fused node chains and groups, see fuse.c
+struct plan_group
+{
+	S8 entries_max;
+	S8 *entries;			// plan entries of the group, in plan order
+	fann_type **inputs;		// inputs_f of the entries
+	struct kernel *kernel;	// group kernel, NULL = not run as a group
+};
+
+struct plan_fuse
+{
+	S8 entries_max;
+	S8 chains_max;
+	S8 nodes_max;			// nodes in all chains
+	S8 *head;				// per plan entry: first entry of its chain, -1 = not fused
+	S8 *tail;				// per first entry: last entry of the chain
+	S8 *next;				// per plan entry: next entry of the chain, -1 = none
+	struct kernel **kernel;	// per first entry: fused kernel of the chain
+	S8 groups_max;
+	S8 group_nodes_max;		// nodes in all groups
+	S8 *group;				// per plan entry: its group, -1 = none
+	struct plan_group *groups;
+};
+
+// compact link of a plan: 8 bytes, node is the plan entry of the linked node
+#define PLAN_LINK_NODE_MAX 0xFFFFFFFFLL
+#define PLAN_LINK_PORT_MAX 0xFFFFLL
+
+struct plan_link
+{
+	U4 node;
+	U2 node_input;
+	U2 node_output;
+};
+
+#define PLAN_STALE 2			// dirty flag: the outputs of the entry were not set by the last run
+
+struct plan
+{
+	S8 topology;			// cell topology the plan was compiled from
+	S8 entries_max;
+	struct plan_entry *entries;
+	S8 links_max;
+	struct plan_link *links;
+	S8 ranges_max;
+	struct plan_range *ranges;	// the links of every entry as range copies
+	S8 aliases_max;			// entries with inputs in the outputs of a linked node
+	S8 *alias;				// per entry: entry with its inputs in the outputs, -1 = none
+	S8 *alias_output;		// per entry: first output of the alias entry
+	struct plan_pull *pulls;	// the ranges of every layer, sorted by the linked entry
+	S8 *pull_groups;		// start of every linked entry in pulls, one more at the end
+	S8 layers_max;
+	struct plan_layer *layers;
+	S8 *node_entry;			// plan entry of every node, -1 = not in plan
+	U1 storage;
+
+	// hot node data of the plan entries, as parallel arrays:
+	struct fann **ann;
+	struct memo **memo;
+	struct kernel **kernel;
+	S8 *inputs;
+	S8 *outputs;
+	F8 **inputs_nodef;
+	F8 **outputs_nodef;
+	fann_type **inputs_f;
+	fann_type **outputs_f;
+	U1 *dirty;				// per entry: inputs changed since the last run, or PLAN_STALE
+	struct plan_batch *batch;
+	struct plan_cone *cones;	// last used first
+	struct plan_fuse *fuse;		// fused chains, NULL = none
+	struct kernel **prefetch;	// per entry: kernel which runs after it, see slab.c
+	S8 *cone_targets;
+	U1 *cone_mark;
+};
+
+
+// fast math activation table, see fast.c
+struct fast
+{
+	F8 max_error;
+	fann_type range;		// tanh is +-1 outside of -range ... range
+	fann_type scale;		// table steps per 1.0
+	S8 size;
+	fann_type *values;		// tanh at -range + i / scale
+};
+
+// thread pool job, see pool.c
+typedef void (*pool_job) (struct pool *pool, S8 thread, void *arg);
+
+// protos
+// cells.c:
+S2 run_node (struct neuron *neuron);
+S2 run_node_f (struct neuron *neuron);
+// plan.c:
+S2 plan_check (struct cell *cells, S8 cell);
+S2 plan_run_cell (struct cell *cells, S8 cell, S8 start_layer, S8 end_layer);
+S2 plan_run (struct plan *plan, S8 start_layer, S8 end_layer);
+S2 plan_run_entry (struct plan *plan, S8 e);
+S2 plan_run_node (struct plan *plan, S8 e, S8 start_layer, S8 end_layer);
+void plan_copy_links (struct plan *plan, S8 e);
+void plan_pull_links (struct plan *plan, S8 group, S8 start_layer, S8 end_layer);
+void plan_free (struct cell *cells, S8 cell);
+void plan_mark_dirty (struct cell *cells, S8 cell, S8 node);
+// pool.c:
+S8 pool_threads (struct pool *pool);
+S2 pool_run (struct pool *pool, pool_job job, void *arg);
+void pool_barrier (struct pool *pool, int *sense);
+S8 pool_next (struct pool *pool, S8 chunk);
+void pool_error (struct pool *pool);
+S2 pool_failed (struct pool *pool);
+int pool_sense (struct pool *pool);
+// batch.c:
+void batch_free (struct plan_batch *batch);
+// demand.c:
+void plan_cones_free (struct plan *plan);
+// alloc.c:
+void *cells_calloc (S8 n, S8 size);
+void *cells_aligned_alloc (S8 size);
+void cells_free (void *ptr);
+struct arena *arena_create (S8 reserve);
+void *arena_alloc (struct arena *arena, S8 size, S8 align);
+void arena_free (struct arena *arena);
+S8 arena_bytes (struct arena *arena);
+void *cell_calloc (struct cell *cells, S8 cell, S8 n, S8 size);
+void *cell_aligned_alloc (struct cell *cells, S8 cell, S8 size);
+void cell_free (struct cell *cells, S8 cell, void *ptr);
+struct slab *slab_create (S8 size, U1 huge);
+void *slab_alloc (struct slab *slab, S8 size);
+void slab_free (struct slab *slab);
+void slab_keep (struct slab *slab, struct slab *older);
+S8 slab_bytes (struct slab *slab);
+U1 slab_pages (struct slab *slab);
+// names.c:
+S2 names_intern (struct cell *cells, U1 *name, S8 *id);
+U1 *names_get (struct cell *cells, S8 id);
+void names_set_node (struct cell *cells, S8 cell, S8 node, S8 id);
+S8 names_count (struct cell *cells);
+void names_free (struct names *names);
+// memo.c:
+fann_type *memo_run (struct memo *memo, struct fann *ann, struct kernel *kernel, fann_type *input);
+void memo_free (struct memo *memo);
+void memo_flush (struct memo *memo);
+// kernel.c:
+S2 kernel_create (struct fann *ann, struct kernel **kernel_ret);
+S2 kernel_node (struct cell *cells, S8 cell, S8 node);
+S2 kernel_compare (struct kernel *kernel, struct fann *ann, S8 samples, U1 grid, F8 *max_error);
+fann_type *kernel_run (struct kernel *kernel, struct fann *ann, fann_type *input);
+void kernel_free (struct kernel *kernel);
+void kernel_set_fast (struct kernel *kernel, struct fast *fast);
+S2 kernel_set_weights (struct kernel *kernel, U1 weights);
+U1 kernel_weights (struct kernel *kernel);
+S8 kernel_weights_bytes (struct kernel *kernel, S8 *float_bytes);
+fann_type *kernel_run_float (struct kernel *kernel, fann_type *input);
+S8 kernel_layers (struct kernel *kernel);
+void kernel_layer_get (struct kernel *kernel, S8 layer, S8 *inputs, S8 *outputs, S8 *cols, fann_type **weights);
+void kernel_activate (struct kernel *kernel, S8 layer, fann_type *sums, fann_type *x);
+void kernel_set_quant (struct kernel *kernel, struct quant *quant);
+struct quant *kernel_get_quant (struct kernel *kernel);
+U1 kernel_sparse (struct kernel *kernel);
+U1 kernel_fusable (struct kernel *kernel);
+S2 kernel_fuse (struct kernel **kernels, S8 kernels_max, S8 **maps, struct kernel **fused_ret);
+U1 kernel_same (struct kernel *a, struct kernel *b);
+S2 kernel_group (struct kernel **kernels, S8 kernels_max, struct kernel **group_ret);
+fann_type *kernel_group_run (struct kernel *group, fann_type **inputs, S8 nodes);
+S8 kernel_group_lanes (struct kernel *group);
+S2 kernel_clone (struct kernel *kernel, struct kernel **clone_ret);
+S8 kernel_slab_bytes (struct kernel *kernel);
+S2 kernel_slab_pack (struct kernel *kernel, struct slab *slab);
+void kernel_prefetch (struct kernel *kernel);
+// fast.c:
+struct fast *fast_create (F8 max_error);
+void fast_free (struct fast *fast);
+S8 fast_bytes (struct fast *fast);
+// quant.c:
+fann_type *quant_run (struct quant *quant, struct kernel *kernel, fann_type *input);
+void quant_free (struct quant *quant);
+S2 quant_clone (struct quant *quant, struct quant **clone_ret);
+// fuse.c:
+S2 fuse_plan (struct plan *plan, U1 fusion);
+void fuse_free (struct plan_fuse *fuse);
+U1 fuse_whole (struct plan *plan, S8 e, S8 start_layer, S8 end_layer);
+U1 fuse_inner (struct plan *plan, S8 e, S8 start_layer, S8 end_layer);
+void fuse_run (struct plan *plan, S8 head);
+U1 fuse_grouped (struct plan *plan, S8 e);
+S2 fuse_clone (struct plan_fuse *fuse, struct plan *plan, struct plan_fuse **clone_ret);
+void fuse_clone_free (struct plan_fuse *clone);
+struct kernel *fuse_kernel (struct plan *plan, S8 e);
+// slab.c:
+void slab_plan (struct plan *plan);
+// bind.c:
+S2 bind_plan (struct cell *cells, S8 cell, struct plan *plan);
+void bind_free (struct bind *bind);
+U1 bind_get_output (struct cell *cells, S8 cell, S8 node, S8 output, F8 *value);
+void bind_set_inputs (struct cell *cells, S8 cell, S8 node, F8 *inputs);
+void *bind_values (struct cell *cells, S8 cell, S8 node, U1 outputs);
+void bind_read_inputs (struct cell *cells, S8 cell, S8 node);
+void bind_write_outputs (struct cell *cells, S8 cell, S8 node);
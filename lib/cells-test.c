@@ -0,0 +1,1022 @@
+/*
+* This file cells-test.c is part of Cells.
+*
+* (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+*
+* Cells is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Cells is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Tests of the library, built and run by make-cells.sh:
+ * ./cells-test [fann directory], default "../fann"
+ *
+ * The native kernels are checked with Cells_kernel_selftest on all
+ * instruction sets of the CPU. Then graphs of the xor, or and and nets of
+ * the fann directory are run with every run function, and the outputs are
+ * compared with Cells_fann_run_ann_go_links on the same graph. 16 bit
+ * weights, int8 kernels, node caches and packed weights are checked the
+ * same way, within the tolerances below. Returns 1 if a test failed.
+ *
+ * malloc, calloc, realloc and the aligned allocations are replaced by
+ * counting functions, for all code of the process: a run of a loaded graph
+ * must not allocate. This needs the __libc_* functions of glibc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "cells.h"
+
+#define TEST_CELLS 3
+#define TEST_WIDTH 8			// nodes per layer
+#define TEST_LAYERS 4
+#define TEST_NODES (TEST_WIDTH * TEST_LAYERS)
+#define TEST_ROUNDS 8
+#define TEST_BATCH 5
+#define TEST_THREADS 4
+#define TEST_SAMPLES 1000
+#define TEST_FUSED_TOLERANCE 1.0e-3	// fused kernels add the sums in another order
+#define TEST_F16_TOLERANCE 1.0e-2	// 16 bit weights: the errors add up over the layers of the graph
+#define TEST_BF16_TOLERANCE 1.0e-1
+#define TEST_QUANT_TOLERANCE 2.0e-1	// int8 kernels, over all layers of the graph
+#define TEST_MEMO_CAPACITY 4
+
+#define GRAPH_CROSS 0			// node (l, k) to (l + 1, k) and (l + 1, k + 1): no chains
+#define GRAPH_COLUMNS 1			// node (l, k) to both inputs of (l + 1, k): fused chains
+
+#define TEST_FILE "cells-test.cells"
+
+U1 test_nets[3][256];
+S8 test_failed = 0;
+
+// allocation counter
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+
+volatile U1 test_allocs_on = FALSE;
+volatile S8 test_allocs = 0;
+
+void *malloc (size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	return (__libc_malloc (size));
+}
+
+void *calloc (size_t n, size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	return (__libc_calloc (n, size));
+}
+
+void *realloc (void *ptr, size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	return (__libc_realloc (ptr, size));
+}
+
+void *memalign (size_t alignment, size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	return (__libc_memalign (alignment, size));
+}
+
+void *aligned_alloc (size_t alignment, size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	return (__libc_memalign (alignment, size));
+}
+
+int posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+	if (test_allocs_on == TRUE) test_allocs++;
+	*ptr = __libc_memalign (alignment, size);
+	return (*ptr == NULL ? 12 : 0);
+}
+
+void test_result (const char *name, S8 bad)
+{
+	if (bad != 0)
+	{
+		printf ("%s: FAILED: %lli mismatches!\n", name, bad);
+		test_failed++;
+		return;
+	}
+	printf ("%s: OK\n", name);
+}
+
+void test_free (struct cell *cells)
+{
+	if (cells == NULL)
+	{
+		return;
+	}
+	Cells_dealloc_neurons (cells, TEST_CELLS);
+	free (cells);
+}
+
+struct cell *test_graph (U1 graph, U1 kernel, U1 fusion)
+{
+	// TEST_CELLS cells of TEST_LAYERS layers, the nets in turns
+	struct cell *cells;
+	F8 inputs[2] = {0.0, 0.0};
+	F8 outputs[1] = {0.0};
+	S8 i, l, k, node;
+
+	// not zeroed memory: Cells_init_cells must clear it
+	cells = (struct cell *) malloc (TEST_CELLS * sizeof (struct cell));
+	if (cells == NULL)
+	{
+		printf ("ERROR: can't allocate %i cells!\n", TEST_CELLS);
+		return (NULL);
+	}
+	memset (cells, 0xA5, TEST_CELLS * sizeof (struct cell));
+	Cells_init_cells (cells, TEST_CELLS);
+
+	if (Cells_alloc_neurons_equal (cells, TEST_CELLS, TEST_NODES) != 0)
+	{
+		printf ("ERROR: can't allocate memory for neurons!\n");
+		free (cells);
+		return (NULL);
+	}
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (node = 0; node < TEST_NODES; node++)
+		{
+			if (Cells_fann_read_ann (cells, i, node, test_nets[(node + i) % 3], 2, 1, inputs, outputs, node / TEST_WIDTH, 1) != 0)
+			{
+				printf ("ERROR: can't read ANN: %s!\n", test_nets[(node + i) % 3]);
+				test_free (cells);
+				return (NULL);
+			}
+		}
+
+		for (l = 0; l < TEST_LAYERS - 1; l++)
+		{
+			for (k = 0; k < TEST_WIDTH; k++)
+			{
+				node = l * TEST_WIDTH + k;
+				if (Cells_alloc_node_links (cells, i, node, 2) != 0)
+				{
+					printf ("ERROR: can't allocate memory for links!\n");
+					test_free (cells);
+					return (NULL);
+				}
+
+				if (graph == GRAPH_COLUMNS)
+				{
+					Cells_set_node_link (cells, i, node, 0, node + TEST_WIDTH, 0, 0);
+					Cells_set_node_link (cells, i, node, 1, node + TEST_WIDTH, 1, 0);
+				}
+				else
+				{
+					Cells_set_node_link (cells, i, node, 0, node + TEST_WIDTH, 0, 0);
+					Cells_set_node_link (cells, i, node, 1, (l + 1) * TEST_WIDTH + (k + 1) % TEST_WIDTH, 1, 0);
+				}
+			}
+		}
+	}
+
+	if (Cells_set_kernel (cells, 0, TEST_CELLS - 1, kernel) != 0 || Cells_set_fusion (cells, 0, TEST_CELLS - 1, fusion) != 0)
+	{
+		printf ("ERROR: can't set kernel or fusion!\n");
+		test_free (cells);
+		return (NULL);
+	}
+	return (cells);
+}
+
+void test_input (S8 round, S8 i, S8 k, F8 *inputs)
+{
+	inputs[0] = (F8) ((round * 7 + i * 5 + k * 3) % 11) / 10.0;
+	inputs[1] = (F8) ((round * 3 + i * 7 + k * 5) % 13) / 12.0;
+}
+
+void test_update (struct cell *cells, S8 round)
+{
+	// new inputs of the first layer
+	F8 inputs[2];
+	S8 i, k;
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (k = 0; k < TEST_WIDTH; k++)
+		{
+			test_input (round, i, k, inputs);
+			Cells_fann_do_update_ann (cells, i, k, inputs);
+		}
+	}
+}
+
+S8 test_compare (struct cell *ref, struct cell *cells, S8 start_node, F8 tolerance)
+{
+	// outputs of the nodes from start_node on which differ more than tolerance
+	F8 a, b;
+	S8 i, node, bad = 0;
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (node = start_node; node < TEST_NODES; node++)
+		{
+			Cells_fann_get_output (ref, i, node, 0, &a);
+			Cells_fann_get_output (cells, i, node, 0, &b);
+			if (fabs (a - b) > tolerance)
+			{
+				bad++;
+			}
+		}
+	}
+	return (bad);
+}
+
+void test_selftest (void)
+{
+	// native kernels against fann_run, all activation functions and instruction sets
+	F8 max_error = 0.0;
+	S8 bad = 0;
+
+	if (Cells_kernel_selftest (TEST_SAMPLES, &max_error) != 0 || max_error > KERNEL_TOLERANCE)
+	{
+		bad = 1;
+	}
+	printf ("kernel selftest: instruction sets up to %i, max error %e\n", Cells_kernel_isa_max (), max_error);
+	test_result ("kernel selftest", bad);
+}
+
+S8 test_runs (struct cell *ref, struct cell *cells, struct pool *pool, U1 run, S8 start_node, F8 tolerance)
+{
+	// run both graphs on the same inputs, ref with Cells_fann_run_ann_go_links
+	S8 targets[TEST_CELLS * TEST_WIDTH];
+	S8 target_cells[TEST_CELLS * TEST_WIDTH];
+	S8 target_outputs[TEST_CELLS * TEST_WIDTH];
+	F8 values[TEST_CELLS * TEST_WIDTH];
+	F8 value;
+	S8 round, i, k, t, bad = 0;
+	S2 ret = 0;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (ref, round);
+		test_update (cells, round);
+		Cells_fann_run_ann_go_links (ref, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+
+		switch (run)
+		{
+			case 0:
+				ret = Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+				break;
+			case 1:
+				ret = Cells_run_plan_dirty (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+				break;
+			case 2:
+				ret = Cells_run_plan_threads (cells, pool, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+				break;
+			case 3:
+				ret = Cells_run_cells_threads (cells, pool, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+				break;
+			case 4:
+				// the last layer of every cell
+				t = 0;
+				for (i = 0; i < TEST_CELLS; i++)
+				{
+					for (k = 0; k < TEST_WIDTH; k++)
+					{
+						target_cells[t] = i;
+						targets[t] = TEST_NODES - TEST_WIDTH + k;
+						target_outputs[t] = 0;
+						t++;
+					}
+				}
+				ret = Cells_run_targets (cells, t, target_cells, targets, target_outputs, values);
+				for (t = 0; ret == 0 && t < TEST_CELLS * TEST_WIDTH; t++)
+				{
+					Cells_fann_get_output (ref, target_cells[t], targets[t], 0, &value);
+					if (fabs (value - values[t]) > tolerance)
+					{
+						bad++;
+					}
+				}
+				break;
+		}
+		if (ret != 0)
+		{
+			printf ("ERROR: run failed!\n");
+			return (1);
+		}
+
+		bad += test_compare (ref, cells, start_node, tolerance);
+	}
+	return (bad);
+}
+
+struct cell *test_load (struct cell *cells)
+{
+	// save and load the graph, read the ANNs
+	struct cell *load;
+	F8 inputs[2] = {0.0, 0.0};
+	F8 outputs[1] = {0.0};
+	S8 i, node;
+
+	if (Cells_fann_save_cells (cells, (U1 *) TEST_FILE, 0, TEST_CELLS - 1) != 0)
+	{
+		printf ("ERROR: can't save cells!\n");
+		return (NULL);
+	}
+
+	load = Cells_fann_load_cells ((U1 *) TEST_FILE);
+	remove (TEST_FILE);
+	if (load == NULL)
+	{
+		printf ("ERROR: can't load cells!\n");
+		return (NULL);
+	}
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (node = 0; node < TEST_NODES; node++)
+		{
+			if (Cells_fann_read_ann (load, i, node, (U1 *) "", 0, 0, inputs, outputs, node / TEST_WIDTH, 0) != 0)
+			{
+				printf ("ERROR: can't read ANN of loaded cells!\n");
+				test_free (load);
+				return (NULL);
+			}
+		}
+	}
+	return (load);
+}
+
+S8 test_weights (struct cell *ref, struct cell *cells, struct pool *pool, U1 weights)
+{
+	// 16 bit weights against fann_run, the weight bytes and the "weights =" lines of the cells file
+	struct cell *load;
+	S8 bytes, saved, load_bytes, load_saved;
+	S8 i, node, round, bad = 0;
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (node = 0; node < TEST_NODES; node++)
+		{
+			if (Cells_set_node_weights (cells, i, node, weights) != 0)
+			{
+				printf ("ERROR: can't set node weights!\n");
+				return (1);
+			}
+		}
+	}
+
+	// half the bytes of float weights
+	if (Cells_weights_bytes (cells, 0, TEST_CELLS - 1, &bytes, &saved) != 0 || bytes == 0 || saved != bytes)
+	{
+		bad++;
+	}
+
+	bad += test_runs (ref, cells, pool, 0, 0, weights == WEIGHTS_F16 ? TEST_F16_TOLERANCE : TEST_BF16_TOLERANCE);
+
+	load = test_load (cells);
+	if (load == NULL)
+	{
+		return (bad + 1);
+	}
+	Cells_set_kernel (load, 0, TEST_CELLS - 1, KERNEL_NATIVE);
+
+	if (Cells_weights_bytes (load, 0, TEST_CELLS - 1, &load_bytes, &load_saved) != 0 || load_bytes != bytes || load_saved != saved)
+	{
+		bad++;
+	}
+
+	// the same kernels: the same outputs
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (cells, round);
+		test_update (load, round);
+		Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+		Cells_run_plan (load, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+		bad += test_compare (cells, load, 0, 0.0);
+	}
+
+	test_free (load);
+	return (bad);
+}
+
+S8 test_quant (struct cell *ref, struct cell *cells, struct pool *pool)
+{
+	// calibrate, int8 kernels against float kernels, then float again
+	F8 max_error;
+	S8 round, bad = 0;
+
+	if (Cells_quant_start (cells, 0, TEST_CELLS - 1, TEST_ROUNDS) != 0)
+	{
+		printf ("ERROR: can't start calibration!\n");
+		return (1);
+	}
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (cells, round);
+		Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	}
+	if (Cells_quant_finish (cells, 0, TEST_CELLS - 1) != 0 || Cells_quant_report (cells, 0, TEST_CELLS - 1, &max_error) != 0)
+	{
+		printf ("ERROR: can't finish calibration!\n");
+		return (1);
+	}
+	if (max_error <= 0.0 || max_error > TEST_QUANT_TOLERANCE)
+	{
+		bad++;
+	}
+
+	bad += test_runs (ref, cells, pool, 0, 0, TEST_QUANT_TOLERANCE);
+
+	if (Cells_quant_clear (cells, 0, TEST_CELLS - 1) != 0)
+	{
+		printf ("ERROR: can't clear calibration!\n");
+		return (1);
+	}
+	bad += test_runs (ref, cells, pool, 0, 0, 0.0);
+	return (bad);
+}
+
+S8 test_memo (struct cell *ref, struct cell *cells)
+{
+	// a cache on every node of the first layer: the same inputs twice, then new ones
+	S8 hits, misses, k, bad = 0;
+
+	for (k = 0; k < TEST_WIDTH; k++)
+	{
+		if (Cells_memo_set (cells, 0, k, TEST_MEMO_CAPACITY, MEMO_EXACT, 0.0, MEMO_EVICT_LRU) != 0)
+		{
+			printf ("ERROR: can't set node cache!\n");
+			return (1);
+		}
+	}
+
+	test_update (ref, 0);
+	Cells_run_plan (ref, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	test_update (cells, 0);
+	Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	test_update (cells, 1);
+	Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	test_update (cells, 0);
+	Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	bad += test_compare (ref, cells, 0, 0.0);
+
+	// round 0 and round 1 miss, round 0 again hits
+	for (k = 0; k < TEST_WIDTH; k++)
+	{
+		if (Cells_memo_stats (cells, 0, k, &hits, &misses) != 0 || hits != 1 || misses != 2)
+		{
+			bad++;
+		}
+	}
+	return (bad);
+}
+
+S8 test_pack (struct cell *ref, struct cell *cells, struct pool *pool)
+{
+	// the kernel weights in one slab: the same outputs
+	S8 bytes;
+	U1 pages;
+	S8 bad = 0;
+
+	if (Cells_pack_weights (cells, TEST_CELLS, FALSE) != 0 || Cells_slab_info (cells, &bytes, &pages) != 0)
+	{
+		printf ("ERROR: can't pack weights!\n");
+		return (1);
+	}
+	if (bytes == 0 || pages != SLAB_PAGES)
+	{
+		bad++;
+	}
+
+	bad += test_runs (ref, cells, pool, 0, 0, TEST_FUSED_TOLERANCE);
+	bad += test_runs (ref, cells, pool, 2, 0, TEST_FUSED_TOLERANCE);
+	return (bad);
+}
+
+S8 test_dirty_mixed (struct cell *ref, struct cell *cells)
+{
+	// incremental runs between whole runs of other inputs: the fused chains must run again
+	S8 round, bad = 0;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (ref, round);
+		Cells_fann_run_ann_go_links (ref, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+
+		test_update (cells, round);
+		Cells_run_plan_dirty (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+		test_update (cells, round + 1);
+		Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+		test_update (cells, round);
+		if (Cells_run_plan_dirty (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS) != 0)
+		{
+			printf ("ERROR: run failed!\n");
+			return (1);
+		}
+
+		bad += test_compare (ref, cells, TEST_NODES - TEST_WIDTH, TEST_FUSED_TOLERANCE);
+	}
+	return (bad);
+}
+
+S8 test_fast_nan (struct cell *cells)
+{
+	// fast math sigmoid kernels: NaN inputs give NaN outputs, as with fann_run
+	F8 inputs[2];
+	F8 value;
+	S8 i, node, k, bad = 0;
+
+	for (i = 0; i < TEST_CELLS; i++)
+	{
+		for (node = 0; node < TEST_NODES; node++)
+		{
+			fann_set_activation_function_hidden (cells[i].neurons[node].ann, FANN_SIGMOID_SYMMETRIC);
+			fann_set_activation_function_output (cells[i].neurons[node].ann, FANN_SIGMOID_SYMMETRIC);
+		}
+	}
+	if (Cells_set_kernel (cells, 0, TEST_CELLS - 1, KERNEL_NATIVE) != 0 || Cells_set_fast_math (cells, 0, TEST_CELLS - 1, 1.0e-4) != 0)
+	{
+		printf ("ERROR: can't set fast math!\n");
+		return (1);
+	}
+
+	test_update (cells, 0);
+	inputs[0] = inputs[1] = NAN;
+	Cells_fann_do_update_ann (cells, 0, 0, inputs);
+	if (Cells_run_plan (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS) != 0)
+	{
+		printf ("ERROR: run failed!\n");
+		return (1);
+	}
+
+	for (k = 0; k < TEST_WIDTH; k++)
+	{
+		Cells_fann_get_output (cells, 0, k, 0, &value);
+		if ((k == 0) != (isnan (value) != 0))
+		{
+			bad++;
+		}
+	}
+	return (bad);
+}
+
+S8 test_batch (struct cell *ref, struct cell *cells)
+{
+	// one batch of TEST_BATCH input rows against one run per row
+	S8 input_nodes[TEST_WIDTH];
+	S8 output_nodes[TEST_WIDTH];
+	F8 *inputs[TEST_WIDTH];
+	F8 *outputs[TEST_WIDTH];
+	F8 input_rows[TEST_WIDTH][TEST_BATCH * 2];
+	F8 output_rows[TEST_WIDTH][TEST_BATCH];
+	F8 value;
+	S8 b, k, bad = 0;
+
+	for (k = 0; k < TEST_WIDTH; k++)
+	{
+		input_nodes[k] = k;
+		output_nodes[k] = TEST_NODES - TEST_WIDTH + k;
+		inputs[k] = input_rows[k];
+		outputs[k] = output_rows[k];
+		for (b = 0; b < TEST_BATCH; b++)
+		{
+			test_input (b, 0, k, &input_rows[k][b * 2]);
+		}
+	}
+
+	if (Cells_run_batch (cells, 0, TEST_BATCH, TEST_WIDTH, input_nodes, inputs, TEST_WIDTH, output_nodes, outputs) != 0)
+	{
+		printf ("ERROR: batch run failed!\n");
+		return (1);
+	}
+
+	for (b = 0; b < TEST_BATCH; b++)
+	{
+		for (k = 0; k < TEST_WIDTH; k++)
+		{
+			Cells_fann_do_update_ann (ref, 0, k, &input_rows[k][b * 2]);
+		}
+		Cells_fann_run_ann_go_links (ref, 0, 0, 0, TEST_LAYERS);
+
+		for (k = 0; k < TEST_WIDTH; k++)
+		{
+			Cells_fann_get_output (ref, 0, output_nodes[k], 0, &value);
+			if (value != output_rows[k][b])
+			{
+				bad++;
+			}
+		}
+	}
+	return (bad);
+}
+
+S8 test_context (struct cell *ref, struct cell *cells)
+{
+	// a run context against the graph
+	struct context *context;
+	F8 inputs[2];
+	F8 value, expect;
+	S8 round, i, k, node, bad = 0;
+
+	context = Cells_context_create (cells, TEST_CELLS);
+	if (context == NULL)
+	{
+		printf ("ERROR: can't create context!\n");
+		return (1);
+	}
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (ref, round);
+		Cells_run_plan (ref, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+
+		for (i = 0; i < TEST_CELLS; i++)
+		{
+			for (k = 0; k < TEST_WIDTH; k++)
+			{
+				test_input (round, i, k, inputs);
+				Cells_context_update (context, i, k, inputs);
+			}
+		}
+		if (Cells_context_run (context, 0, TEST_CELLS - 1, 0, TEST_LAYERS) != 0)
+		{
+			printf ("ERROR: context run failed!\n");
+			Cells_context_free (context);
+			return (1);
+		}
+
+		for (i = 0; i < TEST_CELLS; i++)
+		{
+			for (node = 0; node < TEST_NODES; node++)
+			{
+				Cells_fann_get_output (ref, i, node, 0, &expect);
+				Cells_context_get_output (context, i, node, 0, &value);
+				if (value != expect)
+				{
+					bad++;
+				}
+			}
+		}
+	}
+
+	Cells_context_free (context);
+	return (bad);
+}
+
+S8 test_bind (struct cell *ref, struct cell *cells, U1 storage)
+{
+	// bound inputs of the first layer and outputs of the last layer, read back with the API functions,
+	// Cells_run_plan, Cells_run_targets and Cells_fann_run_ann_go_links in turns
+	S8 input_nodes[TEST_WIDTH];
+	S8 output_nodes[TEST_WIDTH];
+	S8 target_cells[TEST_WIDTH];
+	S8 target_outputs[TEST_WIDTH];
+	F8 inputs_f8[TEST_WIDTH * 2];
+	F8 outputs_f8[TEST_WIDTH];
+	fann_type inputs_fann[TEST_WIDTH * 2];
+	fann_type outputs_fann[TEST_WIDTH];
+	F8 values[TEST_WIDTH];
+	F8 value, expect;
+	S8 round, k, bad = 0;
+	S2 ret;
+
+	for (k = 0; k < TEST_WIDTH; k++)
+	{
+		input_nodes[k] = k;
+		output_nodes[k] = TEST_NODES - TEST_WIDTH + k;
+		target_cells[k] = 0;
+		target_outputs[k] = 0;
+	}
+
+	if (Cells_bind_inputs (cells, 0, TEST_WIDTH, input_nodes, storage == STORAGE_FANN ? (void *) inputs_fann : (void *) inputs_f8) != 0
+		|| Cells_bind_outputs (cells, 0, TEST_WIDTH, output_nodes, storage == STORAGE_FANN ? (void *) outputs_fann : (void *) outputs_f8) != 0)
+	{
+		printf ("ERROR: can't bind buffers!\n");
+		return (1);
+	}
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (ref, round);
+		Cells_fann_run_ann_go_links (ref, 0, 0, 0, TEST_LAYERS);
+
+		// the inputs in the buffer, then Cells_fann_do_update_ann on every second round
+		for (k = 0; k < TEST_WIDTH; k++)
+		{
+			test_input (round, 0, k, &inputs_f8[k * 2]);
+			inputs_fann[k * 2] = inputs_f8[k * 2];
+			inputs_fann[k * 2 + 1] = inputs_f8[k * 2 + 1];
+			if (round % 2 == 1)
+			{
+				inputs_f8[k * 2] = inputs_f8[k * 2 + 1] = inputs_fann[k * 2] = inputs_fann[k * 2 + 1] = 0.0;
+				test_input (round, 0, k, values);
+				Cells_fann_do_update_ann (cells, 0, k, values);
+			}
+		}
+
+		if (round % 3 == 0)
+		{
+			ret = Cells_run_plan (cells, 0, 0, 0, TEST_LAYERS);
+		}
+		else if (round % 3 == 1)
+		{
+			ret = Cells_run_targets (cells, TEST_WIDTH, target_cells, output_nodes, target_outputs, values);
+		}
+		else
+		{
+			ret = Cells_fann_run_ann_go_links (cells, 0, 0, 0, TEST_LAYERS);
+		}
+		if (ret != 0)
+		{
+			printf ("ERROR: run failed!\n");
+			return (1);
+		}
+
+		for (k = 0; k < TEST_WIDTH; k++)
+		{
+			Cells_fann_get_output (ref, 0, output_nodes[k], 0, &expect);
+			Cells_fann_get_output (cells, 0, output_nodes[k], 0, &value);
+			if (value != expect || (storage == STORAGE_FANN ? outputs_fann[k] != (fann_type) expect : outputs_f8[k] != expect))
+			{
+				bad++;
+			}
+			if (round % 3 == 1 && values[k] != expect)
+			{
+				bad++;
+			}
+		}
+	}
+
+	Cells_bind_inputs (cells, 0, 0, NULL, NULL);
+	Cells_bind_outputs (cells, 0, 0, NULL, NULL);
+	return (bad);
+}
+
+S8 test_no_allocs (struct cell *cells)
+{
+	// a loaded graph with its ANNs read: a run must not allocate
+	struct cell *load;
+	S8 round, allocs;
+
+	load = test_load (cells);
+	if (load == NULL)
+	{
+		return (1);
+	}
+
+	test_allocs = 0;
+	test_allocs_on = TRUE;
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (load, round);
+		Cells_fann_run_ann_go_links (load, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	}
+	test_allocs_on = FALSE;
+	allocs = test_allocs;
+
+	// the loaded graph must still run as the saved one
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		test_update (cells, round);
+		Cells_fann_run_ann_go_links (cells, 0, TEST_CELLS - 1, 0, TEST_LAYERS);
+	}
+	allocs += test_compare (cells, load, 0, 0.0);
+
+	test_free (load);
+	return (allocs);
+}
+
+int main (int ac, char *av[])
+{
+	static const char *names[3] = {"xor/xor_float.net", "or/or_float.net", "and/and_float.net"};
+	static const char *runs[5] = {"run_plan", "run_plan_dirty", "run_plan_threads", "run_cells_threads", "run_targets"};
+	const char *fann_dir = "../fann";
+	struct cell *ref;
+	struct cell *cells;
+	struct pool *pool;
+	U1 storage, kernel, run, weights;
+	S8 i;
+	char name[256];
+
+	if (ac > 1)
+	{
+		fann_dir = av[1];
+	}
+	for (i = 0; i < 3; i++)
+	{
+		snprintf ((char *) test_nets[i], sizeof (test_nets[i]), "%s/%s", fann_dir, names[i]);
+	}
+
+	test_selftest ();
+
+	pool = Cells_pool_create (TEST_THREADS);
+	if (pool == NULL)
+	{
+		printf ("ERROR: can't create thread pool!\n");
+		exit (1);
+	}
+
+	// every run function, both storages, FANN and native kernels
+	for (storage = STORAGE_F8; storage <= STORAGE_FANN; storage++)
+	{
+		for (kernel = KERNEL_FANN; kernel <= KERNEL_NATIVE; kernel++)
+		{
+			for (run = 0; run < 5; run++)
+			{
+				ref = test_graph (GRAPH_CROSS, kernel, FUSION_NONE);
+				cells = test_graph (GRAPH_CROSS, kernel, FUSION_NONE);
+				if (ref == NULL || cells == NULL)
+				{
+					exit (1);
+				}
+				Cells_set_storage (ref, 0, TEST_CELLS - 1, storage);
+				Cells_set_storage (cells, 0, TEST_CELLS - 1, storage);
+
+				snprintf (name, sizeof (name), "%s: storage %i, kernel %i", runs[run], storage, kernel);
+				test_result (name, test_runs (ref, cells, pool, run, 0, 0.0));
+
+				test_free (ref);
+				test_free (cells);
+			}
+
+			ref = test_graph (GRAPH_CROSS, kernel, FUSION_NONE);
+			cells = test_graph (GRAPH_CROSS, kernel, FUSION_NONE);
+			if (ref == NULL || cells == NULL)
+			{
+				exit (1);
+			}
+			Cells_set_storage (ref, 0, TEST_CELLS - 1, storage);
+			Cells_set_storage (cells, 0, TEST_CELLS - 1, storage);
+
+			snprintf (name, sizeof (name), "run_batch: storage %i, kernel %i", storage, kernel);
+			test_result (name, test_batch (ref, cells));
+
+			test_free (ref);
+			test_free (cells);
+		}
+	}
+
+	// fused chains and groups: the inner nodes of a chain are not set, check the last layer
+	for (run = 0; run < 4; run++)
+	{
+		ref = test_graph (GRAPH_COLUMNS, KERNEL_NATIVE, FUSION_NONE);
+		cells = test_graph (GRAPH_COLUMNS, KERNEL_NATIVE, FUSION_CHAINS | FUSION_GROUPS | FUSION_LINKS);
+		if (ref == NULL || cells == NULL)
+		{
+			exit (1);
+		}
+
+		snprintf (name, sizeof (name), "%s: fused chains", runs[run]);
+		test_result (name, test_runs (ref, cells, pool, run, TEST_NODES - TEST_WIDTH, TEST_FUSED_TOLERANCE));
+
+		test_free (ref);
+		test_free (cells);
+
+		ref = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+		cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_GROUPS | FUSION_LINKS);
+		if (ref == NULL || cells == NULL)
+		{
+			exit (1);
+		}
+
+		snprintf (name, sizeof (name), "%s: fused groups", runs[run]);
+		test_result (name, test_runs (ref, cells, pool, run, 0, TEST_FUSED_TOLERANCE));
+
+		test_free (ref);
+		test_free (cells);
+	}
+
+	ref = test_graph (GRAPH_COLUMNS, KERNEL_NATIVE, FUSION_NONE);
+	cells = test_graph (GRAPH_COLUMNS, KERNEL_NATIVE, FUSION_CHAINS);
+	if (ref == NULL || cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("run_plan_dirty after run_plan: fused chains", test_dirty_mixed (ref, cells));
+	test_free (ref);
+	test_free (cells);
+
+	// bound buffers
+	for (storage = STORAGE_F8; storage <= STORAGE_FANN; storage++)
+	{
+		ref = test_graph (GRAPH_CROSS, KERNEL_FANN, FUSION_NONE);
+		cells = test_graph (GRAPH_CROSS, KERNEL_FANN, FUSION_NONE);
+		if (ref == NULL || cells == NULL)
+		{
+			exit (1);
+		}
+		Cells_set_storage (ref, 0, TEST_CELLS - 1, storage);
+		Cells_set_storage (cells, 0, TEST_CELLS - 1, storage);
+
+		snprintf (name, sizeof (name), "bound buffers: storage %i", storage);
+		test_result (name, test_bind (ref, cells, storage));
+
+		test_free (ref);
+		test_free (cells);
+	}
+
+	// 16 bit weights
+	for (weights = WEIGHTS_F16; weights <= WEIGHTS_BF16; weights++)
+	{
+		ref = test_graph (GRAPH_CROSS, KERNEL_FANN, FUSION_NONE);
+		cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+		if (ref == NULL || cells == NULL)
+		{
+			exit (1);
+		}
+
+		snprintf (name, sizeof (name), "weights %i: run_plan, weights bytes, save/load", weights);
+		test_result (name, test_weights (ref, cells, pool, weights));
+
+		test_free (ref);
+		test_free (cells);
+	}
+
+	// int8 kernels
+	ref = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+	cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+	if (ref == NULL || cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("int8: calibrate, run_plan, clear", test_quant (ref, cells, pool));
+	test_free (ref);
+	test_free (cells);
+
+	// node caches
+	ref = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+	cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_NONE);
+	if (ref == NULL || cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("node cache: hits and misses", test_memo (ref, cells));
+	test_free (ref);
+	test_free (cells);
+
+	// packed weights, with group kernels
+	ref = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_GROUPS);
+	cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_GROUPS);
+	if (ref == NULL || cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("pack_weights: run_plan, run_plan_threads", test_pack (ref, cells, pool));
+	test_free (ref);
+	test_free (cells);
+
+	// fast math with NaN inputs
+	cells = test_graph (GRAPH_CROSS, KERNEL_FANN, FUSION_NONE);
+	if (cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("fast math: NaN inputs", test_fast_nan (cells));
+	test_free (cells);
+
+	// no allocations in a run of a loaded graph
+	cells = test_graph (GRAPH_CROSS, KERNEL_FANN, FUSION_NONE);
+	if (cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("run_ann_go_links: no allocations", test_no_allocs (cells));
+	test_free (cells);
+
+	// run contexts share the native kernels of the graph
+	ref = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_GROUPS);
+	cells = test_graph (GRAPH_CROSS, KERNEL_NATIVE, FUSION_GROUPS);
+	if (ref == NULL || cells == NULL)
+	{
+		exit (1);
+	}
+	test_result ("context_run", test_context (ref, cells));
+	test_free (ref);
+	test_free (cells);
+
+	Cells_pool_free (pool);
+
+	if (test_failed > 0)
+	{
+		printf ("\n%lli tests FAILED!\n", test_failed);
+		exit (1);
+	}
+	printf ("\nall tests OK\n");
+	exit (0);
+}
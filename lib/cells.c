@@ -24,9 +24,23 @@
 #include <string.h>
 #include <inttypes.h>
 
-#include "cells.h"
+#include "cells-internal.h"
 
 
+S2 Cells_init_cells (struct cell *cells, S8 max_cells)
+{
+	// clear a cells array which is not allocated with calloc, before Cells_alloc_neurons
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("init_cells: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+	
+	memset (cells, 0, max_cells * sizeof (struct cell));
+	return (0);
+}
+
 S2 Cells_alloc_neurons_equal (struct cell *cells, S8 max_cells, S8 neurons)
 {
 	S8 i, n;
@@ -41,17 +55,27 @@ S2 Cells_alloc_neurons_equal (struct cell *cells, S8 max_cells, S8 neurons)
 	for (i = 0; i < max_cells; i++)
 	{
 		cells[i].neurons_max = neurons;
-		cells[i].neurons = (struct neuron *) calloc (neurons, sizeof (struct neuron));
+		cells[i].topology++;
+		cells[i].neurons = (struct neuron *) cell_calloc (cells, i, neurons, sizeof (struct neuron));
 		if (cells[i].neurons == NULL)
 		{
 			printf ("alloc_nerons_equal: ERROR: can't allocate %lli neurons in cell %lli!\n", neurons, i);
 			return (1);
 		}
 		
+		cells[i].cold = (struct neuron_cold *) cell_calloc (cells, i, neurons, sizeof (struct neuron_cold));
+		if (cells[i].cold == NULL)
+		{
+			printf ("alloc_nerons_equal: ERROR: can't allocate %lli neurons names in cell %lli!\n", neurons, i);
+			return (1);
+		}
+		
 		for (n = 0; n < neurons; n++)
 		{
 			cells[i].neurons[n].type = EMPTY;
 			cells[i].neurons[n].ann = NULL;
+			cells[i].neurons[n].memo = NULL;
+			cells[i].neurons[n].kernel = NULL;
 			cells[i].neurons[n].fann_state = ANNCLOSED;
 			cells[i].neurons[n].layer = 0;
 			cells[i].neurons[n].inputs = 0;
@@ -60,6 +84,8 @@ S2 Cells_alloc_neurons_equal (struct cell *cells, S8 max_cells, S8 neurons)
 			cells[i].neurons[n].links = NULL;
 			cells[i].neurons[n].inputs_nodef = NULL;
 			cells[i].neurons[n].outputs_nodef = NULL;
+			cells[i].neurons[n].inputs_f = NULL;
+			cells[i].neurons[n].outputs_f = NULL;
 		}
 	}
 	return (0);
@@ -77,17 +103,27 @@ S2 Cells_alloc_neurons (struct cell *cells, S8 cell, S8 neurons)
 	}
 	
 	cells[cell].neurons_max = neurons;
-	cells[cell].neurons = (struct neuron *) calloc (neurons, sizeof (struct neuron));
+	cells[cell].topology++;
+	cells[cell].neurons = (struct neuron *) cell_calloc (cells, cell, neurons, sizeof (struct neuron));
 	if (cells[cell].neurons == NULL)
 	{
 		printf ("alloc_neurons: can't allocate %lli neurons in cell %lli!\n", neurons, cell);
 		return (1);
 	}
 	
+	cells[cell].cold = (struct neuron_cold *) cell_calloc (cells, cell, neurons, sizeof (struct neuron_cold));
+	if (cells[cell].cold == NULL)
+	{
+		printf ("alloc_neurons: can't allocate %lli neurons names in cell %lli!\n", neurons, cell);
+		return (1);
+	}
+	
 	for (n = 0; n < neurons; n++)
 	{
 		cells[cell].neurons[n].type = EMPTY;
 		cells[cell].neurons[n].ann = NULL;
+		cells[cell].neurons[n].memo = NULL;
+		cells[cell].neurons[n].kernel = NULL;
 		cells[cell].neurons[n].fann_state = ANNCLOSED;
 		cells[cell].neurons[n].layer = 0;
 		cells[cell].neurons[n].inputs = 0;
@@ -96,6 +132,8 @@ S2 Cells_alloc_neurons (struct cell *cells, S8 cell, S8 neurons)
 		cells[cell].neurons[n].links = NULL;
 		cells[cell].neurons[n].inputs_nodef = NULL;
 		cells[cell].neurons[n].outputs_nodef = NULL;
+		cells[cell].neurons[n].inputs_f = NULL;
+		cells[cell].neurons[n].outputs_f = NULL;
 	}
 	return (0);
 }
@@ -116,12 +154,35 @@ S2 Cells_dealloc_neurons (struct cell *cells, S8 max_cells)
 	{
 		for (n = 0; n < cells[i].neurons_max; n++)
 		{
-			if (cells[i].neurons[n].inputs_nodef) free (cells[i].neurons[n].inputs_nodef);
-			if (cells[i].neurons[n].outputs_nodef) free (cells[i].neurons[n].outputs_nodef);
-			if (cells[i].neurons[n].links) free (cells[i].neurons[n].links);
+			if (cells[i].neurons[n].inputs_nodef) cell_free (cells, i, cells[i].neurons[n].inputs_nodef);
+			if (cells[i].neurons[n].outputs_nodef) cell_free (cells, i, cells[i].neurons[n].outputs_nodef);
+			if (cells[i].neurons[n].inputs_f) cell_free (cells, i, cells[i].neurons[n].inputs_f);
+			if (cells[i].neurons[n].outputs_f) cell_free (cells, i, cells[i].neurons[n].outputs_f);
+			if (cells[i].neurons[n].links) cell_free (cells, i, cells[i].neurons[n].links);
 			if (cells[i].neurons[n].fann_state == ANNOPEN) fann_destroy (cells[i].neurons[n].ann);
+			if (cells[i].neurons[n].memo) memo_free (cells[i].neurons[n].memo);
+			if (cells[i].neurons[n].kernel) kernel_free (cells[i].neurons[n].kernel);
 		}
-		free (cells[i].neurons);
+		cell_free (cells, i, cells[i].neurons);
+		if (cells[i].cold) cell_free (cells, i, cells[i].cold);
+		cells[i].cold = NULL;
+		plan_free (cells, i);
+		if (cells[i].fast) fast_free (cells[i].fast);
+		cells[i].fast = NULL;
+		if (cells[i].bind) bind_free (cells[i].bind);
+		cells[i].bind = NULL;
+	}
+	
+	if (max_cells > 0 && cells[0].names)
+	{
+		names_free (cells[0].names);
+		cells[0].names = NULL;
+	}
+
+	if (max_cells > 0 && cells[0].slab)
+	{
+		slab_free (cells[0].slab);
+		cells[0].slab = NULL;
 	}
 	return (0);
 }
@@ -149,6 +210,16 @@ S2 Cells_fann_do_update_ann (struct cell *cells, S8 cell, S8 node, F8 *inputs_no
 		cells[cell].neurons[node].inputs_nodef[n] = inputs_node[n];
 	}
 	
+	if (cells[cell].neurons[node].inputs_f != NULL)
+	{
+		for (n = 0; n < cells[cell].neurons[node].inputs; n++)
+		{
+			cells[cell].neurons[node].inputs_f[n] = inputs_node[n];
+		}
+	}
+	
+	bind_set_inputs (cells, cell, node, inputs_node);
+	plan_mark_dirty (cells, cell, node);
 	return (0);
 }
 
@@ -158,6 +229,8 @@ S2 Cells_fann_read_ann (struct cell *cells, S8 cell, S8 node, U1 *filename, S8 i
 	
 	S8 n;
 	S8 filename_len;
+	S8 name_id;
+	struct fann *ann;
 	
 	if (cells == NULL)
 	{
@@ -173,35 +246,50 @@ S2 Cells_fann_read_ann (struct cell *cells, S8 cell, S8 node, U1 *filename, S8 i
 		return (1);
 	}
 	
-	filename_len = strlen_safe ((const char *) filename, MAXFANNNAME - 1);
-	if (filename_len + 1 > MAXFANNNAME)
- 	{
-		printf ("fann_read_ann: error fileaname too long!\n");
-		return (1);
-	}
-	
+	// the name table has no length limit, empty name: load the ANN of the node again
+	filename_len = strlen ((const char *) filename);
+	name_id = cells[cell].cold[node].fann_name;
 	if (filename_len > 0)
 	{
-		strcpy ((char *) cells[cell].neurons[node].fann_name, (const char *) filename);
+		if (names_intern (cells, filename, &name_id) != 0)
+		{
+			printf ("fann_read_ann: ERROR: can't set ANN file name!\n");
+			return (1);
+		}
 	}
 	
-	// printf ("fann_read_ann: ann filename: '%s'\n", cells[cell].neurons[node].fann_name);
+	// printf ("fann_read_ann: ann filename: '%s'\n", names_get (cells, name_id));
 	
 	// printf ("fann_read_ann: cell: %lli, node: %lli\n", cell, node);
-	cells[cell].neurons[node].type = ANN;
-	cells[cell].neurons[node].ann = (struct fann *) fann_create_from_file ((const char*) cells[cell].neurons[node].fann_name);
+	ann = (struct fann *) fann_create_from_file ((const char*) names_get (cells, name_id));
 	
 	// return value check!!!
-	if (cells[cell].neurons[node].ann == NULL)
+	if (ann == NULL)
 	{
-		printf ("fann_read_ann: ERROR: can't open ANN file: '%s'!\n", cells[cell].neurons[node].fann_name);
-		// reset file name
-		strcpy ((char *) cells[cell].neurons[node].fann_name, (const char *) "");
+		// the node keeps its old name and ANN
+		printf ("fann_read_ann: ERROR: can't open ANN file: '%s'!\n", names_get (cells, name_id));
 		// ERROR RETURN
 		return (1);
 	}
 	
+	names_set_node (cells, cell, node, name_id);
+	cells[cell].neurons[node].type = ANN;
+	cells[cell].neurons[node].ann = ann;
 	cells[cell].neurons[node].fann_state = ANNOPEN;
+	cells[cell].topology++;
+	
+	// new ANN: the cache must be set again
+	if (cells[cell].neurons[node].memo != NULL)
+	{
+		memo_free (cells[cell].neurons[node].memo);
+		cells[cell].neurons[node].memo = NULL;
+	}
+	
+	if (kernel_node (cells, cell, node) != 0)
+	{
+		printf ("fann_read_ann: ERROR: can't build ANN kernel!\n");
+		return (1);
+	}
 	
 	if (init == 1)
  	{
@@ -219,7 +307,7 @@ S2 Cells_fann_read_ann (struct cell *cells, S8 cell, S8 node, U1 *filename, S8 i
 	
 	// allocate and copy neurons inputs/outputs;
 	
-	cells[cell].neurons[node].inputs_nodef = calloc (inputs, sizeof (F8));
+	cells[cell].neurons[node].inputs_nodef = cell_calloc (cells, cell, inputs, sizeof (F8));
 	if (cells[cell].neurons[node].inputs_nodef == NULL)
 	{
 		printf ("fann_read_ann: ERROR: can't allocate inputs nodes!\n");
@@ -230,7 +318,7 @@ S2 Cells_fann_read_ann (struct cell *cells, S8 cell, S8 node, U1 *filename, S8 i
 		cells[cell].neurons[node].inputs_nodef[n] = inputs_node[n];
 	}
 	
-	cells[cell].neurons[node].outputs_nodef = calloc (outputs, sizeof (F8));
+	cells[cell].neurons[node].outputs_nodef = cell_calloc (cells, cell, outputs, sizeof (F8));
 	if (cells[cell].neurons[node].outputs_nodef == NULL)
 	{
 		printf ("fann_read_ann: ERROR: can't allocate outputs nodes!\n");
@@ -240,16 +328,69 @@ S2 Cells_fann_read_ann (struct cell *cells, S8 cell, S8 node, U1 *filename, S8 i
 	{
 		cells[cell].neurons[node].outputs_nodef[n] = outputs_node[n];
 	}
+	
+	// staging buffer for the ANN inputs, so a run doesn't allocate memory
+	if (cells[cell].neurons[node].inputs_f) cell_free (cells, cell, cells[cell].neurons[node].inputs_f);
+	cells[cell].neurons[node].inputs_f = cell_aligned_alloc (cells, cell, inputs * sizeof (fann_type));
+	if (cells[cell].neurons[node].inputs_f == NULL)
+	{
+		printf ("fann_read_ann: ERROR: can't allocate inputs staging buffer!\n");
+		return (1);
+	}
+	for (n = 0; n < inputs; n++)
+	{
+		cells[cell].neurons[node].inputs_f[n] = inputs_node[n];
+	}
+	
+	if (cells[cell].neurons[node].outputs_f) cell_free (cells, cell, cells[cell].neurons[node].outputs_f);
+	cells[cell].neurons[node].outputs_f = cell_aligned_alloc (cells, cell, outputs * sizeof (fann_type));
+	if (cells[cell].neurons[node].outputs_f == NULL)
+	{
+		printf ("fann_read_ann: ERROR: can't allocate outputs buffer!\n");
+		return (1);
+	}
+	for (n = 0; n < outputs; n++)
+	{
+		cells[cell].neurons[node].outputs_f[n] = outputs_node[n];
+	}
 	return (0);
 }
 
-S2 Cells_fann_run_ann (struct cell *cells, S8 cell, S8 node)
+S2 run_node (struct neuron *neuron)
 {
+	// run one ANN node, no range checks: callers must check the node!
 	S8 i;
 	
-	fann_type *input_f;
 	fann_type *output_f;
 	
+	for (i = 0; i < neuron->inputs; i++)
+	{
+		neuron->inputs_f[i] = neuron->inputs_nodef[i];
+	}
+	
+	output_f = memo_run (neuron->memo, neuron->ann, neuron->kernel, neuron->inputs_f);
+	
+	for (i = 0; i < neuron->outputs; i++)
+	{
+		neuron->outputs_nodef[i] = output_f[i];
+	}
+	
+	return (0);
+}
+
+S2 run_node_f (struct neuron *neuron)
+{
+	// run one ANN node in STORAGE_FANN, no range checks: callers must check the node!
+	fann_type *output_f;
+	
+	output_f = memo_run (neuron->memo, neuron->ann, neuron->kernel, neuron->inputs_f);
+	memcpy (neuron->outputs_f, output_f, neuron->outputs * sizeof (fann_type));
+	
+	return (0);
+}
+
+S2 Cells_fann_run_ann (struct cell *cells, S8 cell, S8 node)
+{
 	if (cells == NULL)
 	{
 		// error: not allocated memory
@@ -264,35 +405,19 @@ S2 Cells_fann_run_ann (struct cell *cells, S8 cell, S8 node)
 		return (1);
 	}
 	
-	// printf ("fann_run_ann: cell: %lli, node: %lli\n", cell, node);
-	
-	input_f = calloc (cells[cell].neurons[node].inputs, sizeof (fann_type));
-	if (input_f == NULL)
+	if (cells[cell].neurons[node].inputs_f == NULL)
 	{
-		printf ("run ann: out of memory, allocating input!\n");
+		printf ("fann_run_ann: error: node has no ANN!\n");
 		return (1);
 	}
 	
-	for (i = 0; i < cells[cell].neurons[node].inputs; i++)
-	{
-		input_f[i] = cells[cell].neurons[node].inputs_nodef[i];
-	}
-	
-	output_f = fann_run (cells[cell].neurons[node].ann, input_f);
-	
-	for (i = 0; i < cells[cell].neurons[node].outputs; i++)
-	{
-		cells[cell].neurons[node].outputs_nodef[i] = output_f[i];
-	}
+	// printf ("fann_run_ann: cell: %lli, node: %lli\n", cell, node);
 	
-	for (i = 0; i < cells[cell].neurons[node].outputs; i++)
+	if (cells[cell].storage == STORAGE_FANN)
 	{
-		// printf ("run ann: cell: %lli, node: %lli, output %lli: %lf\n", cell, node, i, cells[cell].neurons[node].outputs_nodef[i]);
+		return (run_node_f (&cells[cell].neurons[node]));
 	}
-	
-	free (input_f);
-	
-	return (0);
+	return (run_node (&cells[cell].neurons[node]));
 }
 
 S2 Cells_fann_get_output (struct cell *cells, S8 cell, S8 node, S8 output, F8 *return_value)
@@ -318,6 +443,18 @@ S2 Cells_fann_get_output (struct cell *cells, S8 cell, S8 node, S8 output, F8 *r
 		return (1);
 	}
 	
+	// bound outputs: the plan runs write the buffer
+	if (bind_get_output (cells, cell, node, output, return_value) == TRUE)
+	{
+		return (0);
+	}
+	
+	if (cells[cell].storage == STORAGE_FANN)
+	{
+		return_value[0] = cells[cell].neurons[node].outputs_f[output];
+		return (0);
+	}
+	
 	return_value[0] = cells[cell].neurons[node].outputs_nodef[output];
 	return (0);
 }
@@ -331,13 +468,14 @@ S2 Cells_alloc_node_links (struct cell *cells, S8 cell, S8 node, S8 links)
 		return (1);
 	}
 	
-	cells[cell].neurons[node].links = calloc (links, sizeof (struct link));
+	cells[cell].neurons[node].links = cell_calloc (cells, cell, links, sizeof (struct link));
 	if (cells[cell].neurons[node].links == NULL)
 	{
 		printf ("alloc_node_links: out of memory, allocating links!\n");
 		return (1);
 	}
 	cells[cell].neurons[node].links_max = links;
+	cells[cell].topology++;
 	return (0);
 }
 
@@ -353,9 +491,10 @@ S2 Cells_dealloc_node_links (struct cell *cells, S8 cell, S8 node)
 
 	if (cells[cell].neurons[node].links != NULL)
 	{
-		free (cells[cell].neurons[node].links);
+		cell_free (cells, cell, cells[cell].neurons[node].links);
 	    cells[cell].neurons[node].links = NULL;
 		cells[cell].neurons[node].links_max = 0;
+		cells[cell].topology++;
 	}
 
 	return (0);
@@ -389,6 +528,12 @@ S2 Cells_set_node_link (struct cell *cells, S8 cell, S8 node, S8 link, S8 link_n
 		return (1);
 	}
 	
+	if (link_node < 0 || link_node >= cells[cell].neurons_max)
+	{
+		printf ("set_node_link: error: link node out of range!\n");
+		return (1);
+	}
+	
 	// inputs/outputs sense check:
 	if (input >= cells[cell].neurons[link_node].inputs || input < 0)
 	{
@@ -407,6 +552,7 @@ S2 Cells_set_node_link (struct cell *cells, S8 cell, S8 node, S8 link, S8 link_n
 		cells[cell].neurons[node].links[link].node = link_node;
 		cells[cell].neurons[node].links[link].node_input = input;
 		cells[cell].neurons[node].links[link].node_output = output;
+		cells[cell].topology++;
 		return (0);
 	}
 	else
@@ -456,12 +602,33 @@ S2 Cells_fann_get_max_nodes (struct cell *cells, S8 cell, S8 *neurons_max_ret)
 	return (0);
 }
 
+S2 Cells_fann_get_name (struct cell *cells, S8 cell, S8 node, U1 **name)
+{
+	// name is set to the entry in the name table, don't change it
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("fann_get_name: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+	
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("fann_get_name: error: node out of range!\n");
+		return (1);
+	}
+	
+	*name = names_get (cells, cells[cell].cold[node].fann_name);
+	return (0);
+}
+
 S2 Cells_fann_run_ann_go_links (struct cell *cells, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
 {
 	S8 i, j;
 	S8 n;
 	S8 linked_neuron, node_input, node_output;
 	S8 layer;
+	void *bound;
 
 	if (cells == NULL)
 	{
@@ -480,11 +647,16 @@ S2 Cells_fann_run_ann_go_links (struct cell *cells, S8 start_cell, S8 end_cell,
 				{
 					// cell is in current layer, do run 
 				
+					// bound buffers: as the plan runs, read the inputs from and write the outputs to them
+					if (cells[i].bind != NULL) bind_read_inputs (cells, i, n);
+					
 					if (Cells_fann_run_ann (cells, i, n) != 0)
 					{
 						printf ("fann_run_ann_go_links: error running ANN!\n");
 						return (1);
 					}
+					
+					if (cells[i].bind != NULL) bind_write_outputs (cells, i, n);
 				
 					// check for links from this cell
 					if (cells[i].neurons[n].links_max > 0)
@@ -494,8 +666,26 @@ S2 Cells_fann_run_ann_go_links (struct cell *cells, S8 start_cell, S8 end_cell,
 							linked_neuron = cells[i].neurons[n].links[j].node; // node to we are linked
 							node_input = cells[i].neurons[n].links[j].node_input; // input of linked node
 							node_output = cells[i].neurons[n].links[j].node_output; // output of this node, linked to input of next layer node
-						
-							cells[i].neurons[linked_neuron].inputs_nodef[node_input] = cells[i].neurons[n].outputs_nodef[node_output];
+
+							if (cells[i].bind != NULL && (bound = bind_values (cells, i, linked_neuron, FALSE)) != NULL)
+							{
+								if (cells[i].storage == STORAGE_FANN)
+								{
+									((fann_type *) bound)[node_input] = cells[i].neurons[n].outputs_f[node_output];
+								}
+								else
+								{
+									((F8 *) bound)[node_input] = cells[i].neurons[n].outputs_nodef[node_output];
+								}
+							}
+							else if (cells[i].storage == STORAGE_FANN)
+							{
+								cells[i].neurons[linked_neuron].inputs_f[node_input] = cells[i].neurons[n].outputs_f[node_output];
+							}
+							else
+							{
+								cells[i].neurons[linked_neuron].inputs_nodef[node_input] = cells[i].neurons[n].outputs_nodef[node_output];
+							}
 						}
 					}
 				}
@@ -504,3 +694,67 @@ S2 Cells_fann_run_ann_go_links (struct cell *cells, S8 start_cell, S8 end_cell,
 	}
 	return (0);
 }
+
+
+S2 Cells_set_storage (struct cell *cells, S8 start_cell, S8 end_cell, U1 storage)
+{
+	// switch the inputs/outputs storage of the nodes, the values are converted
+	S8 i, n, k;
+	struct neuron *neuron;
+	
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("set_storage: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+	
+	if (storage != STORAGE_F8 && storage != STORAGE_FANN)
+	{
+		printf ("set_storage: error: unknown storage: %i!\n", storage);
+		return (1);
+	}
+	
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (cells[i].storage == storage)
+		{
+			continue;
+		}
+		
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			neuron = &cells[i].neurons[n];
+			if (neuron->inputs_f == NULL || neuron->outputs_f == NULL)
+			{
+				continue;
+			}
+			
+			if (storage == STORAGE_FANN)
+			{
+				for (k = 0; k < neuron->inputs; k++)
+				{
+					neuron->inputs_f[k] = neuron->inputs_nodef[k];
+				}
+				for (k = 0; k < neuron->outputs; k++)
+				{
+					neuron->outputs_f[k] = neuron->outputs_nodef[k];
+				}
+			}
+			else
+			{
+				for (k = 0; k < neuron->inputs; k++)
+				{
+					neuron->inputs_nodef[k] = neuron->inputs_f[k];
+				}
+				for (k = 0; k < neuron->outputs; k++)
+				{
+					neuron->outputs_nodef[k] = neuron->outputs_f[k];
+				}
+			}
+		}
+		cells[i].storage = storage;
+		cells[i].topology++;
+	}
+	return (0);
+}
@@ -21,12 +21,15 @@
 #include <floatfann.h>
 
 
+typedef signed char             S1;		/* BYTE    */
 typedef unsigned char           U1;		/* UBYTE   */
 typedef int16_t                 S2;     /* INT     */
 typedef uint16_t                U2;  	/* UINT */
 typedef int32_t                 S4;     /* LONGINT */
+typedef uint32_t                U4;     /* ULONGINT */
 
 typedef long long               S8;     /* 64 bit long */
+typedef unsigned long long      U8;     /* 64 bit unsigned long */
 typedef double                  F8;     /* DOUBLE */
 
 
@@ -43,6 +46,12 @@ typedef double                  F8;     /* DOUBLE */
 #define TRUE 1
 #define FALSE 0
 
+#define CELLS_ALIGN 64		// cache line, alignment of the node buffers
+
+// node inputs/outputs storage of a cell
+#define STORAGE_F8 0			// F8 inputs_nodef/outputs_nodef
+#define STORAGE_FANN 1			// fann_type inputs_f/outputs_f, F8 only at the API functions
+
 
 struct link
 {
@@ -60,19 +69,99 @@ struct neuron
 	F8 *outputs_nodef;
 	S8 links_max;
 	struct link *links;
-	U1 fann_name[MAXFANNNAME];
+	U1 fann_name[MAXFANNNAME];	// copy of the ANN name, Cells_fann_get_name has the whole name
 	struct fann *ann;			// fann neural network
 	U1 fann_state;
 	S8 layer;
+	fann_type *inputs_f;		// aligned staging buffer for fann_run, inputs in STORAGE_FANN
+	fann_type *outputs_f;		// outputs in STORAGE_FANN
+	struct memo *memo;			// outputs cache, NULL = none
+	struct kernel *kernel;		// native kernel, NULL = fann_run
 };
 
+// cold node data and compiled plan of a cell, see cells-internal.h
+struct neuron_cold;
+struct plan;
+
+// the cells array must be zeroed: allocate it with calloc or clear it with Cells_init_cells
 struct cell
 {
 	S8 neurons_max;
 	struct neuron *neurons;
+	struct neuron_cold *cold;
+	S8 topology;			// increased on every change of nodes or links
+	struct plan *plan;
+	U1 storage;				// STORAGE_F8 or STORAGE_FANN
+	struct arena *arena;	// node memory, NULL = heap
+	struct names *names;	// ANN name table of the graph, only in cells[0]
+	U1 kernel;				// KERNEL_FANN or KERNEL_NATIVE
+	struct fast *fast;		// activation table of the kernels, NULL = exact
+	U1 fusion;				// FUSION_NONE or FUSION_CHAINS | FUSION_GROUPS
+	struct slab *slab;		// kernel weights slab of the graph, only in cells[0]
+	struct bind *bind;		// caller buffers of node inputs/outputs, NULL = none
 };
 
+// memory arena, see alloc.c
+struct arena;
+
+// kernel weights slab, see alloc.c and slab.c
+struct slab;
+
+#define SLAB_PAGES 0			// slab memory: normal pages
+#define SLAB_HUGETLB 1			// reserved huge pages
+#define SLAB_THP 2				// transparent huge pages
+
+// bound input/output buffers, see bind.c
+struct bind;
+
+// run context of a graph, see context.c
+struct context;
+
+// name table, see names.c
+struct names;
+
+// node outputs cache, see memo.c
+struct memo;
+
+#define MEMO_EXACT 0			// memo key modes
+#define MEMO_QUANT 1
+#define MEMO_EVICT_LRU 0		// memo eviction
+#define MEMO_EVICT_FIFO 1
+
+// native ANN kernel, see kernel.c
+struct kernel;
+
+#define KERNEL_FANN 0			// cell kernel: run with fann_run
+#define KERNEL_NATIVE 1			// native kernel, if the ANN is supported
+#define KERNEL_ISA_SCALAR 0		// kernel instruction sets
+#define KERNEL_ISA_AVX2 1
+#define KERNEL_ISA_AVX512 2
+#define KERNEL_TOLERANCE 1.0e-4	// max difference to fann_run
+#define KERNEL_SPARSE_DENSITY 0.3	// layers with less weights not zero are sparse
+#define WEIGHTS_F32 0			// node kernel weights
+#define WEIGHTS_F16 1
+#define WEIGHTS_BF16 2
+
+#define FUSION_NONE 0			// cell fusion, see fuse.c
+#define FUSION_CHAINS 1			// fuse chains of linked nodes into one kernel
+#define FUSION_GROUPS 2			// run same-shape nodes of a layer as one kernel
+#define FUSION_LINKS 4			// node inputs in the outputs of the linked node, see plan.c
+#define FUSION_GROUP_MAX 64		// nodes in a group
+
+// fast math activation table, see fast.c
+struct fast;
+
+#define FAST_ERROR_MIN 1.0e-6	// max error of an activation
+#define FAST_ERROR_MAX 1.0e-1
+
+// int8 layers of a kernel, see quant.c
+struct quant;
+
+// thread pool, see pool.c
+struct pool;
+
 // protos
+S2 Cells_init_cells (struct cell *cells, S8 max_cells);
 S2 Cells_alloc_neurons_equal (struct cell *cells, S8 max_cells, S8 neurons);
 S2 Cells_alloc_neurons (struct cell *cells, S8 cell, S8 neurons);
 S2 Cells_dealloc_neurons (struct cell *cells, S8 max_cells);
@@ -86,10 +175,73 @@ S2 Cells_fann_get_output (struct cell *cells, S8 cell, S8 node, S8 output, F8 *r
 S2 Cells_fann_do_update_ann (struct cell *cells, S8 cell, S8 node, F8 *inputs_node);
 S2 Cells_fann_get_max_layer (struct cell *cells, S8 start_cell, S8 end_cell, S8 *max_layer_ret);
 S2 Cells_fann_get_max_nodes (struct cell *cells, S8 cell, S8 *neurons_max_ret);
+S2 Cells_fann_get_name (struct cell *cells, S8 cell, S8 node, U1 **name);
+S2 Cells_set_storage (struct cell *cells, S8 start_cell, S8 end_cell, U1 storage);
 // file.c:
 char *fgets_uni (char *str, int len, FILE *fptr);
 S2 Cells_fann_save_cells (struct cell *cells, U1 *filename, S8 start_cell, S8 end_cell);
 struct cell *Cells_fann_load_cells (U1 *filename);
+struct cell *Cells_fann_load_cells_arena (U1 *filename, S8 reserve);
+// plan.c:
+S2 Cells_compile_plan (struct cell *cells, S8 start_cell, S8 end_cell);
+S2 Cells_run_plan (struct cell *cells, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer);
+S2 Cells_link_ranges (struct cell *cells, S8 cell, S8 *links, S8 *ranges, S8 *aliases);
+S2 Cells_run_plan_dirty (struct cell *cells, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer);
+// pool.c:
+struct pool *Cells_pool_create (S8 threads);
+S2 Cells_pool_free (struct pool *pool);
+S2 Cells_run_plan_threads (struct cell *cells, struct pool *pool, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer);
+S2 Cells_run_cells_threads (struct cell *cells, struct pool *pool, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer);
+// batch.c:
+S2 Cells_run_batch (struct cell *cells, S8 cell, S8 batch, S8 inputs_max, S8 *input_nodes, F8 **inputs, S8 outputs_max, S8 *output_nodes, F8 **outputs);
+// demand.c:
+S2 Cells_run_targets (struct cell *cells, S8 targets_max, S8 *target_cells, S8 *target_nodes, S8 *target_outputs, F8 *values);
+// alloc.c:
+S2 Cells_alloc_guard (U1 on);
+S8 Cells_alloc_guard_count (void);
+struct cell *Cells_alloc_cells_arena (S8 max_cells, S8 neurons, S8 reserve);
+S2 Cells_dealloc_cells_arena (struct cell *cells, S8 max_cells);
+S8 Cells_arena_bytes (struct cell *cells);
+// names.c:
+S8 Cells_names_bytes (struct cell *cells);
+// memo.c:
+S2 Cells_memo_set (struct cell *cells, S8 cell, S8 node, S8 capacity, U1 mode, F8 quant, U1 evict);
+S2 Cells_memo_stats (struct cell *cells, S8 cell, S8 node, S8 *hits, S8 *misses);
+// kernel.c:
+S2 Cells_set_kernel (struct cell *cells, S8 start_cell, S8 end_cell, U1 kernel);
+S2 Cells_kernel_set_isa (U1 isa);
+U1 Cells_kernel_isa (void);
+U1 Cells_kernel_isa_max (void);
+S2 Cells_kernel_set_sparse (F8 density);
+S2 Cells_kernel_verify (struct cell *cells, S8 cell, S8 node, S8 samples, F8 *max_error);
+S2 Cells_kernel_selftest (S8 samples, F8 *max_error);
+S2 Cells_set_node_weights (struct cell *cells, S8 cell, S8 node, U1 weights);
+S2 Cells_weights_bytes (struct cell *cells, S8 start_cell, S8 end_cell, S8 *bytes, S8 *saved);
+// fast.c:
+S2 Cells_set_fast_math (struct cell *cells, S8 start_cell, S8 end_cell, F8 max_error);
+S2 Cells_fast_math_validate (struct cell *cells, S8 start_cell, S8 end_cell, F8 max_error, S8 samples, F8 *deviation);
+// quant.c:
+S2 Cells_quant_start (struct cell *cells, S8 start_cell, S8 end_cell, S8 samples_max);
+S2 Cells_quant_finish (struct cell *cells, S8 start_cell, S8 end_cell);
+S2 Cells_quant_clear (struct cell *cells, S8 start_cell, S8 end_cell);
+S2 Cells_quant_report (struct cell *cells, S8 start_cell, S8 end_cell, F8 *max_error);
+// fuse.c:
+S2 Cells_set_fusion (struct cell *cells, S8 start_cell, S8 end_cell, U1 fusion);
+S2 Cells_fusion_chains (struct cell *cells, S8 cell, S8 *chains, S8 *nodes);
+S2 Cells_fusion_groups (struct cell *cells, S8 cell, S8 *groups, S8 *nodes);
+// slab.c:
+S2 Cells_pack_weights (struct cell *cells, S8 max_cells, U1 huge);
+S2 Cells_slab_info (struct cell *cells, S8 *bytes, U1 *pages);
+// bind.c:
+S2 Cells_bind_inputs (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, void *buffer);
+S2 Cells_bind_outputs (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, void *buffer);
+S8 Cells_bind_size (struct cell *cells, S8 cell, S8 nodes_max, S8 *nodes, U1 outputs);
+// context.c:
+struct context *Cells_context_create (struct cell *cells, S8 max_cells);
+S2 Cells_context_free (struct context *context);
+S2 Cells_context_run (struct context *context, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer);
+S2 Cells_context_update (struct context *context, S8 cell, S8 node, F8 *inputs_node);
+S2 Cells_context_get_output (struct context *context, S8 cell, S8 node, S8 output, F8 *return_value);
 // string.c:
 size_t strlen_safe (const char *str, S8  maxlen);
 S2 searchstr (U1 *str, U1 *srchstr, S2 start, S2 end, U1 case_sens);
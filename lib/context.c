@@ -0,0 +1,441 @@
+/*
+ * This file context.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Run contexts:
+ * The compiled plans and the kernels of a graph are the model: nodes,
+ * links and weights. A run changes only the inputs/outputs of the nodes
+ * and the run buffers of the kernels. Cells_context_create (cells,
+ * max_cells) makes a run context with its own copy of this state: the
+ * node inputs/outputs of all plan entries and kernels which share the
+ * layers (the weights) of the graph kernels, with their own run buffers.
+ * The context plan shares the entries, links, fused chains and groups of
+ * the graph plan.
+ *
+ * Every thread can run its own context at the same time, with no locks:
+ * Cells_context_update sets the inputs of a node, Cells_context_run runs
+ * the plans like Cells_run_plan, Cells_context_get_output returns an
+ * output. Bound buffers (see bind.c) are not used, a context starts with
+ * the node inputs/outputs of the graph at its creation.
+ *
+ * The graph must not change while contexts run. A context runs no more
+ * after a change of its cells (the topology counter), then create it
+ * again. All nodes of the cells need a native kernel (Cells_set_kernel):
+ * fann_run changes the neuron values of the FANN network, so it can't be
+ * shared, and a copy per context would copy the weights. Cells_context_create
+ * returns an error for a node without one. The memo caches of the nodes are
+ * not used: they are changed by every run. Int8 kernels which are still
+ * calibrated run their float layers.
+ *
+ * With FUSION_LINKS the inputs of an aliased node are the outputs of the
+ * linked node, Cells_context_update returns an error for such a node.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+#define CONTEXT_SIZE(bytes) (((bytes) + CELLS_ALIGN - 1) & ~((S8) CELLS_ALIGN - 1))
+
+struct context_cell
+{
+	S8 topology;			// topology of the graph plan
+	struct plan *shared;	// plan of the graph, only compared
+	struct plan *plan;		// plan of the context, NULL = cell has no nodes
+	U1 *buffer;				// inputs/outputs of all entries
+};
+
+struct context
+{
+	struct cell *cells;
+	S8 cells_max;
+	struct context_cell *cell;
+};
+
+static void context_plan_free (struct context_cell *cell)
+{
+	// free what belongs to the context, the graph plan arrays are shared
+	struct plan *plan;
+	S8 e;
+
+	plan = cell->plan;
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		if (plan->kernel && plan->kernel[e]) kernel_free (plan->kernel[e]);
+	}
+	if (plan->ann) cells_free (plan->ann);
+	if (plan->memo) cells_free (plan->memo);
+	if (plan->kernel) cells_free (plan->kernel);
+	if (plan->inputs_f) cells_free (plan->inputs_f);
+	if (plan->outputs_f) cells_free (plan->outputs_f);
+	if (plan->inputs_nodef) cells_free (plan->inputs_nodef);
+	if (plan->outputs_nodef) cells_free (plan->outputs_nodef);
+	if (plan->dirty) cells_free (plan->dirty);
+	if (plan->fuse) fuse_clone_free (plan->fuse);
+	if (cell->buffer) cells_free (cell->buffer);
+	cells_free (plan);
+	cell->plan = NULL;
+}
+
+static S2 context_plan (struct context_cell *cell, struct plan *shared)
+{
+	// plan of the context: own node inputs/outputs and kernels
+	struct plan *plan;
+	U1 *buffer;
+	S8 e, f, bytes = 0;
+
+	plan = (struct plan *) cells_calloc (1, sizeof (struct plan));
+	if (plan == NULL)
+	{
+		return (1);
+	}
+
+	*plan = *shared;
+	plan->batch = NULL;
+	plan->cones = NULL;
+	plan->cone_targets = NULL;
+	plan->cone_mark = NULL;
+	plan->fuse = NULL;
+	cell->plan = plan;
+
+	plan->ann = (struct fann **) cells_calloc (plan->entries_max + 1, sizeof (struct fann *));
+	plan->memo = (struct memo **) cells_calloc (plan->entries_max + 1, sizeof (struct memo *));
+	plan->kernel = (struct kernel **) cells_calloc (plan->entries_max + 1, sizeof (struct kernel *));
+	plan->inputs_f = (fann_type **) cells_calloc (plan->entries_max + 1, sizeof (fann_type *));
+	plan->outputs_f = (fann_type **) cells_calloc (plan->entries_max + 1, sizeof (fann_type *));
+	plan->inputs_nodef = (F8 **) cells_calloc (plan->entries_max + 1, sizeof (F8 *));
+	plan->outputs_nodef = (F8 **) cells_calloc (plan->entries_max + 1, sizeof (F8 *));
+	plan->dirty = (U1 *) cells_calloc (plan->entries_max + 1, sizeof (U1));
+	if (plan->ann == NULL || plan->memo == NULL || plan->kernel == NULL || plan->inputs_f == NULL || plan->outputs_f == NULL
+		|| plan->inputs_nodef == NULL || plan->outputs_nodef == NULL || plan->dirty == NULL)
+	{
+		return (1);
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		bytes += CONTEXT_SIZE (plan->inputs[e] * (S8) sizeof (fann_type)) + CONTEXT_SIZE (plan->outputs[e] * (S8) sizeof (fann_type))
+			+ CONTEXT_SIZE (plan->inputs[e] * (S8) sizeof (F8)) + CONTEXT_SIZE (plan->outputs[e] * (S8) sizeof (F8));
+	}
+	cell->buffer = (U1 *) cells_aligned_alloc (bytes);
+	if (cell->buffer == NULL)
+	{
+		return (1);
+	}
+
+	buffer = cell->buffer;
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		plan->inputs_f[e] = (fann_type *) buffer;
+		buffer += CONTEXT_SIZE (plan->inputs[e] * (S8) sizeof (fann_type));
+		plan->outputs_f[e] = (fann_type *) buffer;
+		buffer += CONTEXT_SIZE (plan->outputs[e] * (S8) sizeof (fann_type));
+		plan->inputs_nodef[e] = (F8 *) buffer;
+		buffer += CONTEXT_SIZE (plan->inputs[e] * (S8) sizeof (F8));
+		plan->outputs_nodef[e] = (F8 *) buffer;
+		buffer += CONTEXT_SIZE (plan->outputs[e] * (S8) sizeof (F8));
+
+		// start with the values of the graph
+		memcpy (plan->inputs_f[e], shared->inputs_f[e], plan->inputs[e] * sizeof (fann_type));
+		memcpy (plan->outputs_f[e], shared->outputs_f[e], plan->outputs[e] * sizeof (fann_type));
+		memcpy (plan->inputs_nodef[e], shared->inputs_nodef[e], plan->inputs[e] * sizeof (F8));
+		memcpy (plan->outputs_nodef[e], shared->outputs_nodef[e], plan->outputs[e] * sizeof (F8));
+		plan->dirty[e] = 1;
+
+		// the FANN network is only read, the native kernel runs
+		plan->ann[e] = shared->ann[e];
+		if (kernel_clone (shared->kernel[e], &plan->kernel[e]) != 0)
+		{
+			return (1);
+		}
+	}
+
+	// FUSION_LINKS: the inputs in the outputs of the linked entry
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		f = plan->alias[e];
+		if (f < 0)
+		{
+			continue;
+		}
+
+		if (plan->storage == STORAGE_FANN)
+		{
+			plan->inputs_f[e] = plan->outputs_f[f] + plan->alias_output[e];
+		}
+		else
+		{
+			plan->inputs_nodef[e] = plan->outputs_nodef[f] + plan->alias_output[e];
+		}
+	}
+
+	if (shared->fuse != NULL && fuse_clone (shared->fuse, plan, &plan->fuse) != 0)
+	{
+		return (1);
+	}
+	return (0);
+}
+
+static S2 context_kernels (struct cell *cells, S8 cell)
+{
+	// all plan entries need a native kernel, fann_run is not thread safe
+	struct plan *plan;
+	S8 e;
+
+	plan = cells[cell].plan;
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		if (plan->kernel[e] == NULL)
+		{
+			printf ("context_create: error: node has no native kernel, use Cells_set_kernel: cell: %lli, node: %lli!\n", cell, plan->entries[e].node);
+			return (1);
+		}
+	}
+	return (0);
+}
+
+struct context *Cells_context_create (struct cell *cells, S8 max_cells)
+{
+	// run context of the cells 0 ... max_cells - 1, their plans are compiled if needed
+	struct context *context;
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("context_create: ERROR: cells structure not allocated!\n");
+		return (NULL);
+	}
+
+	context = (struct context *) cells_calloc (1, sizeof (struct context));
+	if (context == NULL)
+	{
+		printf ("context_create: out of memory, allocating context!\n");
+		return (NULL);
+	}
+
+	context->cells = cells;
+	context->cells_max = max_cells;
+	context->cell = (struct context_cell *) cells_calloc (max_cells + 1, sizeof (struct context_cell));
+	if (context->cell == NULL)
+	{
+		printf ("context_create: out of memory, allocating context!\n");
+		Cells_context_free (context);
+		return (NULL);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		if (cells[i].neurons == NULL)
+		{
+			continue;
+		}
+
+		if (plan_check (cells, i) != 0)
+		{
+			printf ("context_create: error compiling cell: %lli!\n", i);
+			Cells_context_free (context);
+			return (NULL);
+		}
+
+		if (context_kernels (cells, i) != 0)
+		{
+			Cells_context_free (context);
+			return (NULL);
+		}
+
+		context->cell[i].topology = cells[i].topology;
+		context->cell[i].shared = cells[i].plan;
+		if (context_plan (&context->cell[i], cells[i].plan) != 0)
+		{
+			printf ("context_create: out of memory, allocating context plan: cell: %lli!\n", i);
+			Cells_context_free (context);
+			return (NULL);
+		}
+	}
+	return (context);
+}
+
+S2 Cells_context_free (struct context *context)
+{
+	S8 i;
+
+	if (context == NULL)
+	{
+		printf ("context_free: ERROR: context not allocated!\n");
+		return (1);
+	}
+
+	if (context->cell)
+	{
+		for (i = 0; i < context->cells_max; i++)
+		{
+			if (context->cell[i].plan) context_plan_free (&context->cell[i]);
+		}
+		cells_free (context->cell);
+	}
+	cells_free (context);
+	return (0);
+}
+
+static S2 context_check (struct context *context, S8 cell, const char *func)
+{
+	// the graph plan of the cell must be the one of the context
+	if (cell < 0 || cell >= context->cells_max)
+	{
+		printf ("%s: error: cell out of range: %lli!\n", func, cell);
+		return (1);
+	}
+
+	if (context->cells[cell].plan != context->cell[cell].shared || context->cells[cell].topology != context->cell[cell].topology)
+	{
+		printf ("%s: error: cell changed, create the context again: cell: %lli!\n", func, cell);
+		return (1);
+	}
+	return (0);
+}
+
+S2 Cells_context_run (struct context *context, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
+{
+	// run the plans of the cells with the context state
+	S8 i;
+
+	if (context == NULL)
+	{
+		printf ("context_run: ERROR: context not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (context_check (context, i, "context_run") != 0)
+		{
+			return (1);
+		}
+
+		if (context->cell[i].plan == NULL)
+		{
+			continue;
+		}
+
+		if (plan_run (context->cell[i].plan, start_layer, end_layer) != 0)
+		{
+			return (1);
+		}
+	}
+	return (0);
+}
+
+static S8 context_entry (struct context *context, S8 cell, S8 node, const char *func)
+{
+	// plan entry of a node, -1 = error
+	struct plan *plan;
+
+	if (context_check (context, cell, func) != 0)
+	{
+		return (-1);
+	}
+
+	plan = context->cell[cell].plan;
+	if (plan == NULL || node < 0 || node >= context->cells[cell].neurons_max || plan->node_entry[node] < 0)
+	{
+		printf ("%s: error: node not in plan: cell: %lli, node: %lli!\n", func, cell, node);
+		return (-1);
+	}
+	return (plan->node_entry[node]);
+}
+
+S2 Cells_context_update (struct context *context, S8 cell, S8 node, F8 *inputs_node)
+{
+	// set the inputs of a node in the context
+	struct plan *plan;
+	S8 e, i;
+
+	if (context == NULL)
+	{
+		printf ("context_update: ERROR: context not allocated!\n");
+		return (1);
+	}
+
+	e = context_entry (context, cell, node, "context_update");
+	if (e < 0)
+	{
+		return (1);
+	}
+
+	plan = context->cell[cell].plan;
+	if (plan->alias[e] >= 0)
+	{
+		// FUSION_LINKS: the inputs are the outputs of the linked node
+		printf ("context_update: error: node inputs are linked outputs (FUSION_LINKS): cell: %lli, node: %lli!\n", cell, node);
+		return (1);
+	}
+
+	for (i = 0; i < plan->inputs[e]; i++)
+	{
+		if (plan->storage == STORAGE_FANN)
+		{
+			plan->inputs_f[e][i] = inputs_node[i];
+		}
+		else
+		{
+			plan->inputs_nodef[e][i] = inputs_node[i];
+		}
+	}
+	plan->dirty[e] = 1;
+	return (0);
+}
+
+S2 Cells_context_get_output (struct context *context, S8 cell, S8 node, S8 output, F8 *return_value)
+{
+	struct plan *plan;
+	S8 e;
+
+	if (context == NULL)
+	{
+		printf ("context_get_output: ERROR: context not allocated!\n");
+		return (1);
+	}
+
+	e = context_entry (context, cell, node, "context_get_output");
+	if (e < 0)
+	{
+		return (1);
+	}
+
+	plan = context->cell[cell].plan;
+	if (output < 0 || output >= plan->outputs[e])
+	{
+		printf ("context_get_output: error: output out of range!\n");
+		return (1);
+	}
+
+	if (plan->storage == STORAGE_FANN)
+	{
+		*return_value = plan->outputs_f[e][output];
+	}
+	else
+	{
+		*return_value = plan->outputs_nodef[e][output];
+	}
+	return (0);
+}
@@ -0,0 +1,319 @@
+/*
+ * This file demand.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Demand run:
+ * Cells_run_targets gets a list of (cell, node, output) targets and only runs
+ * the nodes the targets depend on: the target nodes and all nodes which have
+ * a path of links to them (the backward cone). The cone nodes are run in plan
+ * order, so the targets get the same outputs as in a full run.
+ *
+ * The cone of the target nodes of a cell is cached in the cell plan, the next
+ * run with the same target nodes doesn't search the links again. The cache
+ * keeps the last PLAN_CONES_MAX cones, and is gone with the plan on a topology
+ * change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+#define PLAN_CONES_MAX 16
+
+static void cone_free (struct plan_cone *cone)
+{
+	if (cone->targets) cells_free (cone->targets);
+	if (cone->entries) cells_free (cone->entries);
+	cells_free (cone);
+}
+
+void plan_cones_free (struct plan *plan)
+{
+	struct plan_cone *cone;
+	struct plan_cone *next;
+
+	for (cone = plan->cones; cone != NULL; cone = next)
+	{
+		next = cone->next;
+		cone_free (cone);
+	}
+	plan->cones = NULL;
+
+	if (plan->cone_targets) cells_free (plan->cone_targets);
+	if (plan->cone_mark) cells_free (plan->cone_mark);
+}
+
+static int entry_cmp (const void *a, const void *b)
+{
+	const S8 *entry_a = a;
+	const S8 *entry_b = b;
+
+	if (*entry_a != *entry_b)
+	{
+		return (*entry_a < *entry_b ? -1 : 1);
+	}
+	return (0);
+}
+
+static struct plan_cone *cone_build (struct plan *plan, S8 targets_max)
+{
+	// backward cone of the target entries in plan->cone_targets
+	struct plan_cone *cone;
+	struct plan_entry *entry;
+	U1 *mark;
+	U1 changed = TRUE;
+	S8 e, j, t, entries = 0;
+
+	mark = plan->cone_mark;
+	for (t = 0; t < targets_max; t++)
+	{
+		mark[plan->cone_targets[t]] = 1;
+	}
+
+	// backwards through the plan, again for links to lower layers
+	while (changed == TRUE)
+	{
+		changed = FALSE;
+		for (e = plan->entries_max - 1; e >= 0; e--)
+		{
+			if (mark[e] == 1)
+			{
+				continue;
+			}
+
+			entry = &plan->entries[e];
+			for (j = entry->link_start; j < entry->link_end; j++)
+			{
+				if (mark[plan->links[j].node] == 1)
+				{
+					mark[e] = 1;
+					changed = TRUE;
+					break;
+				}
+			}
+		}
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		entries += mark[e];
+	}
+
+	cone = (struct plan_cone *) cells_calloc (1, sizeof (struct plan_cone));
+	if (cone == NULL)
+	{
+		memset (mark, 0, plan->entries_max);
+		return (NULL);
+	}
+
+	cone->targets = (S8 *) cells_calloc (targets_max, sizeof (S8));
+	cone->entries = (S8 *) cells_calloc (entries + 1, sizeof (S8));
+	if (cone->targets == NULL || cone->entries == NULL)
+	{
+		cone_free (cone);
+		memset (mark, 0, plan->entries_max);
+		return (NULL);
+	}
+
+	memcpy (cone->targets, plan->cone_targets, targets_max * sizeof (S8));
+	cone->targets_max = targets_max;
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		if (mark[e] == 1)
+		{
+			cone->entries[cone->entries_max] = e;
+			cone->entries_max++;
+			mark[e] = 0;
+		}
+	}
+	return (cone);
+}
+
+static struct plan_cone *cone_get (struct plan *plan, S8 targets_max)
+{
+	// cached cone of the target entries, the last used cone goes first
+	struct plan_cone *cone;
+	struct plan_cone *prev = NULL;
+	S8 cones = 0;
+
+	for (cone = plan->cones; cone != NULL; cone = cone->next)
+	{
+		if (cone->targets_max == targets_max && memcmp (cone->targets, plan->cone_targets, targets_max * sizeof (S8)) == 0)
+		{
+			if (prev != NULL)
+			{
+				prev->next = cone->next;
+				cone->next = plan->cones;
+				plan->cones = cone;
+			}
+			return (cone);
+		}
+
+		cones++;
+		if (cones == PLAN_CONES_MAX && cone->next != NULL)
+		{
+			// cache full: drop the last used cone
+			cone_free (cone->next);
+			cone->next = NULL;
+		}
+		prev = cone;
+	}
+
+	cone = cone_build (plan, targets_max);
+	if (cone == NULL)
+	{
+		return (NULL);
+	}
+
+	cone->next = plan->cones;
+	plan->cones = cone;
+	return (cone);
+}
+
+static S2 run_targets_cell (struct cell *cells, S8 cell, S8 targets_max, S8 *target_cells, S8 *target_nodes)
+{
+	struct plan *plan;
+	struct plan_cone *cone;
+	S8 c, t, e, targets = 0;
+
+	plan = cells[cell].plan;
+
+	if (plan->cone_targets == NULL)
+	{
+		plan->cone_targets = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+		plan->cone_mark = (U1 *) cells_calloc (plan->entries_max + 1, sizeof (U1));
+		if (plan->cone_targets == NULL || plan->cone_mark == NULL)
+		{
+			printf ("run_targets: out of memory, allocating cone!\n");
+			return (1);
+		}
+	}
+
+	// the target entries of this cell, sorted and once only
+	for (t = 0; t < targets_max; t++)
+	{
+		if (target_cells[t] != cell)
+		{
+			continue;
+		}
+
+		e = plan->node_entry[target_nodes[t]];
+		if (plan->cone_mark[e] == 0)
+		{
+			plan->cone_mark[e] = 1;
+			plan->cone_targets[targets] = e;
+			targets++;
+		}
+	}
+	for (t = 0; t < targets; t++)
+	{
+		plan->cone_mark[plan->cone_targets[t]] = 0;
+	}
+	qsort (plan->cone_targets, targets, sizeof (S8), entry_cmp);
+
+	cone = cone_get (plan, targets);
+	if (cone == NULL)
+	{
+		printf ("run_targets: out of memory, allocating cone!\n");
+		return (1);
+	}
+
+	for (c = 0; c < cone->entries_max; c++)
+	{
+		e = cone->entries[c];
+		if (plan_run_entry (plan, e) != 0)
+		{
+			printf ("run_targets: error running ANN!\n");
+			return (1);
+		}
+
+		plan_copy_links (plan, e);
+	}
+	return (0);
+}
+
+S2 Cells_run_targets (struct cell *cells, S8 targets_max, S8 *target_cells, S8 *target_nodes, S8 *target_outputs, F8 *values)
+{
+	// run only the nodes the targets depend on, values: target outputs or NULL
+	S8 t, i;
+	U1 done;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_targets: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (t = 0; t < targets_max; t++)
+	{
+		if (plan_check (cells, target_cells[t]) != 0)
+		{
+			printf ("run_targets: error compiling cell: %lli!\n", target_cells[t]);
+			return (1);
+		}
+
+		if (target_nodes[t] < 0 || target_nodes[t] >= cells[target_cells[t]].neurons_max || cells[target_cells[t]].plan->node_entry[target_nodes[t]] < 0)
+		{
+			printf ("run_targets: error: target node has no ANN: cell: %lli, node: %lli!\n", target_cells[t], target_nodes[t]);
+			return (1);
+		}
+
+		if (target_outputs[t] < 0 || target_outputs[t] >= cells[target_cells[t]].neurons[target_nodes[t]].outputs)
+		{
+			printf ("run_targets: error: target output out of range: cell: %lli, node: %lli!\n", target_cells[t], target_nodes[t]);
+			return (1);
+		}
+	}
+
+	// every cell of the targets once
+	for (t = 0; t < targets_max; t++)
+	{
+		done = FALSE;
+		for (i = 0; i < t; i++)
+		{
+			if (target_cells[i] == target_cells[t])
+			{
+				done = TRUE;
+				break;
+			}
+		}
+
+		if (done == FALSE)
+		{
+			if (run_targets_cell (cells, target_cells[t], targets_max, target_cells, target_nodes) != 0)
+			{
+				return (1);
+			}
+		}
+	}
+
+	if (values != NULL)
+	{
+		for (t = 0; t < targets_max; t++)
+		{
+			Cells_fann_get_output (cells, target_cells[t], target_nodes[t], target_outputs[t], &values[t]);
+		}
+	}
+	return (0);
+}
@@ -0,0 +1,226 @@
+/*
+ * This file fast.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Fast math:
+ * Cells_set_fast_math (cells, start_cell, end_cell, max_error) lets the native
+ * kernels of the cells compute the sigmoid activation functions with a table
+ * instead of expf. Both are tanh of the (steepness * sum):
+ *
+ *   FANN_SIGMOID_SYMMETRIC: 2 / (1 + exp (-2x)) - 1 = tanh (x)
+ *   FANN_SIGMOID:           1 / (1 + exp (-2x))     = (tanh (x) + 1) / 2
+ *
+ * The table has tanh at equal steps in -range ... range, between the steps
+ * the value is interpolated linearly. Outside of the range tanh is +-1.
+ * The step and range are chosen so that each part of the error is at most
+ * max_error / 2: the interpolation error is step^2 / 8 * max |tanh''|, the
+ * error outside of the range is below 2 * exp (-2 * range).
+ *
+ * max_error bounds the error of one activation. The error of the outputs of
+ * a node also depends on the weights of the layers after it, so
+ * Cells_fast_math_validate measures the output deviation of the nodes, it
+ * prints only errors. The program cells-fast-validate prints it for a file.
+ * The other activation functions are computed as without fast math.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "cells-internal.h"
+
+#define FAST_TANH_D2 0.7698004	// max |tanh''|: 4 / (3 * sqrt (3))
+
+void fast_free (struct fast *fast)
+{
+	if (fast->values) cells_free (fast->values);
+	cells_free (fast);
+}
+
+struct fast *fast_create (F8 max_error)
+{
+	struct fast *fast;
+	F8 step, range;
+	S8 steps, i;
+
+	fast = (struct fast *) cells_calloc (1, sizeof (struct fast));
+	if (fast == NULL)
+	{
+		return (NULL);
+	}
+
+	range = 0.5 * log (4.0 / max_error);
+	step = sqrt (4.0 * max_error / FAST_TANH_D2);
+	steps = (S8) ceil (2.0 * range / step);
+	step = 2.0 * range / steps;
+
+	// one more value at the end: the interpolation of the last step reads it
+	fast->values = (fann_type *) cells_calloc (steps + 2, sizeof (fann_type));
+	if (fast->values == NULL)
+	{
+		fast_free (fast);
+		return (NULL);
+	}
+
+	for (i = 0; i <= steps; i++)
+	{
+		fast->values[i] = (fann_type) tanh (-range + i * step);
+	}
+	fast->values[steps + 1] = fast->values[steps];
+
+	fast->max_error = max_error;
+	fast->range = (fann_type) range;
+	fast->scale = (fann_type) (1.0 / step);
+	fast->size = steps + 2;
+	return (fast);
+}
+
+S8 fast_bytes (struct fast *fast)
+{
+	if (fast == NULL)
+	{
+		return (0);
+	}
+	return (sizeof (struct fast) + fast->size * sizeof (fann_type));
+}
+
+S2 Cells_set_fast_math (struct cell *cells, S8 start_cell, S8 end_cell, F8 max_error)
+{
+	// max_error: max error of an activation, 0.0 = exact activation functions
+	struct fast *fast;
+	struct fast *fast_old;
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("set_fast_math: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (max_error != 0.0 && (max_error < FAST_ERROR_MIN || max_error > FAST_ERROR_MAX))
+	{
+		printf ("set_fast_math: error: max error must be 0.0 or in %e ... %e!\n", FAST_ERROR_MIN, FAST_ERROR_MAX);
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		fast = NULL;
+		if (max_error > 0.0)
+		{
+			fast = fast_create (max_error);
+			if (fast == NULL)
+			{
+				printf ("set_fast_math: out of memory, allocating table!\n");
+				return (1);
+			}
+		}
+
+		// the kernels point to the table of their cell
+		fast_old = cells[i].fast;
+		cells[i].fast = fast;
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (kernel_node (cells, i, n) != 0)
+			{
+				printf ("set_fast_math: error: can't build kernel: cell: %lli, node: %lli!\n", i, n);
+				if (fast_old) fast_free (fast_old);
+				return (1);
+			}
+		}
+		if (fast_old) fast_free (fast_old);
+		cells[i].topology++;
+	}
+	return (0);
+}
+
+S2 Cells_fast_math_validate (struct cell *cells, S8 start_cell, S8 end_cell, F8 max_error, S8 samples, F8 *deviation)
+{
+	// deviation: biggest output difference of a node with fast math to fann_run
+	struct fast *fast;
+	struct kernel *kernel;
+	struct neuron *neuron;
+	F8 error;
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("fast_math_validate: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (max_error < FAST_ERROR_MIN || max_error > FAST_ERROR_MAX)
+	{
+		printf ("fast_math_validate: error: max error must be in %e ... %e!\n", FAST_ERROR_MIN, FAST_ERROR_MAX);
+		return (1);
+	}
+
+	fast = fast_create (max_error);
+	if (fast == NULL)
+	{
+		printf ("fast_math_validate: out of memory, allocating table!\n");
+		return (1);
+	}
+
+	*deviation = 0.0;
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			neuron = &cells[i].neurons[n];
+			if (neuron->fann_state != ANNOPEN)
+			{
+				continue;
+			}
+
+			if (kernel_create (neuron->ann, &kernel) != 0)
+			{
+				fast_free (fast);
+				return (1);
+			}
+
+			if (kernel == NULL)
+			{
+				// no native kernel: the node runs exact
+				continue;
+			}
+
+			kernel_set_fast (kernel, fast);
+			if (kernel_compare (kernel, neuron->ann, samples, FALSE, &error) != 0)
+			{
+				kernel_free (kernel);
+				fast_free (fast);
+				return (1);
+			}
+			kernel_free (kernel);
+
+			if (error > *deviation)
+			{
+				*deviation = error;
+			}
+		}
+	}
+
+	fast_free (fast);
+	return (0);
+}
@@ -24,7 +24,7 @@
 #include <string.h>
 #include <inttypes.h>
 
-#include "cells.h"
+#include "cells-internal.h"
 
 // line input from file
 char *fgets_uni (char *str, int len, FILE *fptr)
@@ -117,6 +117,7 @@ S2 Cells_fann_save_cells (struct cell *cells, U1 *filename, S8 start_cell, S8 en
 {
 	S8 i, l;
 	S8 n;
+	S8 names;
 	
 	FILE *fptr;
 	
@@ -136,7 +137,7 @@ S2 Cells_fann_save_cells (struct cell *cells, U1 *filename, S8 start_cell, S8 en
 	}
 	
 	// save header
-	if (fprintf (fptr, "%s\n", "cells V0.1-save") < 0)
+	if (fprintf (fptr, "%s\n", "cells V0.2-save") < 0)
 	{
 		printf ("fann_save_cells: error saving header to file: %s\n", filename);
 		fclose (fptr);
@@ -151,11 +152,30 @@ S2 Cells_fann_save_cells (struct cell *cells, U1 *filename, S8 start_cell, S8 en
 		return (1);
 	}
 	
+	// save name table, the nodes save the name IDs
+	names = names_count (cells);
+	if (fprintf (fptr, "names = %lli\n", names - 1) < 0)
+	{
+		printf ("fann_save_cells: error saving number of names to file: %s\n", filename);
+		fclose (fptr);
+		return (1);
+	}
+	
+	for (n = 1; n < names; n++)
+	{
+		if (fprintf (fptr, "name_string = %s\n", names_get (cells, n)) < 0)
+		{
+			printf ("fann_save_cells: error saving name to file: %s\n", filename);
+			fclose (fptr);
+			return (1);
+		}
+	}
+	
 	// save cell structure
 	for (i = start_cell; i <= end_cell; i++)
 	{
 		// save cell number
-		if (fprintf (fptr, "cell = %lli\n", start_cell) < 0)
+		if (fprintf (fptr, "cell = %lli\n", i - start_cell) < 0)
 		{
 			printf ("fann_save_cells: error saving cells number to file: %s\n", filename);
 			fclose (fptr);
@@ -212,14 +232,25 @@ S2 Cells_fann_save_cells (struct cell *cells, U1 *filename, S8 start_cell, S8 en
 				return (1);
 			}
 			
-			// save fann name
-			if (fprintf (fptr, "fann_name = %s\n", cells[i].neurons[n].fann_name) < 0)
+			// save fann name ID
+			if (fprintf (fptr, "fann_name_id = %lli\n", cells[i].cold[n].fann_name) < 0)
 			{
 				printf ("fann_save_cells: error saving fann name to file: %s\n", filename);
 				fclose (fptr);
 				return (1);
 			}
 			
+			// save kernel weights, only if not float
+			if (cells[i].cold[n].weights != WEIGHTS_F32)
+			{
+				if (fprintf (fptr, "weights = %i\n", cells[i].cold[n].weights) < 0)
+				{
+					printf ("fann_save_cells: error saving weights to file: %s\n", filename);
+					fclose (fptr);
+					return (1);
+				}
+			}
+			
 			// save links 
 			if (cells[i].neurons[n].links_max > 0)
    			{
@@ -336,7 +367,54 @@ S2 get_string (U1 *buf, U1 *string)
 	return (1);
 }
 
-struct cell *Cells_fann_load_cells (U1 *filename)
+static U1 *load_line (FILE *fptr, U1 **line, S8 *line_max)
+{
+	// read a line of any length into line, without the newline: NULL = end of file or out of memory
+	U1 *bigger;
+	S8 len = 0;
+	int ch, nextch;
+	
+	ch = fgetc (fptr);
+	if (ch == EOF)
+	{
+		return (NULL);
+	}
+	
+	while (ch != EOF && ch != '\n' && ch != '\r')
+	{
+		if (len + 1 >= *line_max)
+		{
+			bigger = (U1 *) cells_calloc (*line_max * 2, sizeof (U1));
+			if (bigger == NULL)
+			{
+				printf ("fann_load_cells: out of memory, allocating line buffer!\n");
+				return (NULL);
+			}
+			memcpy (bigger, *line, len);
+			cells_free (*line);
+			*line = bigger;
+			*line_max *= 2;
+		}
+		(*line)[len] = ch;
+		len++;
+		ch = fgetc (fptr);
+	}
+	
+	if (ch != EOF)
+	{
+		/* check for '\r\n' and '\n\r' */
+		nextch = fgetc (fptr);
+		if (nextch != EOF && nextch != (ch == '\r' ? '\n' : '\r'))
+		{
+			ungetc (nextch, fptr);
+		}
+	}
+	
+	(*line)[len] = '\0';
+	return (*line);
+}
+
+static struct cell *load_cells_file (FILE *fptr, U1 *filename, U1 use_arena, S8 reserve, U1 **line, S8 *line_max)
 {
 	/* The ANNs must be loaded in fann_read_ann() from their filenames as set
 	 * in this cells structure!
@@ -349,39 +427,30 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 	S8 val;
 	S8 max_cells;
 	S8 curr_cell;
-	U1 buf[MAXLINELEN];
-	U1 fann_name[MAXLINELEN];
+	S8 name_id;
+	S8 names = 1;
+	S8 names_saved = -1;
+	U1 *buf;
 	U1 file_eof = 0;
 	
-	FILE *fptr;
-	
 	U1 link_node = 0;
 	U1 link_node_input = 0;
 	U1 link_node_output = 0;
 	U1 link_found_all = 0;
 	
-	fptr = fopen ((const char *) filename, "r");
-	if (fptr == NULL)
-	{
-		printf ("fann_load_cells: error opening file: %s\n", filename);
-		return (NULL);
-	}
-
 	// read header and check
-	if (fgets_uni ((char *) buf, MAXLINELEN, fptr) == NULL)
+	if ((buf = load_line (fptr, line, line_max)) == NULL)
 	{
 		printf ("fann_load_cells: error reading header from file: %s\n", filename);
-		fclose (fptr);
 		return (NULL);
 	}
 	
-	str_cut_newline (buf);
 	// printf ("fann_load_cells: '%s'\n", buf);
 	
-	if (strcmp ((char *) buf, "cells V0.1-save") != 0)
+	// V0.1: every node has its ANN file name, V0.2: name table
+	if (strcmp ((char *) buf, "cells V0.1-save") != 0 && strcmp ((char *) buf, "cells V0.2-save") != 0)
 	{
 		printf ("fann_load_cells: error wrong header from file: %s\n", filename);
-		fclose (fptr);
 		return (NULL);
 	}
 	
@@ -389,14 +458,12 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 	// get number of cells and allocate memory:
 	
 	// read header and check
-	if (fgets_uni ((char *) buf, MAXLINELEN, fptr) == NULL)
+	if ((buf = load_line (fptr, line, line_max)) == NULL)
 	{
 		printf ("fann_load_cells: error reading cells number from file: %s\n", filename);
-		fclose (fptr);
 		return (NULL);
 	}
 	
-	str_cut_newline (buf);
 	// printf ("fann_load_cells: '%s'\n", buf);
 	
 	if (searchstr (buf, (U1 *) "cells =", 0, 0, 1) >= 0)
@@ -406,11 +473,17 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			max_cells = val;
 			// printf ("fann_load_cells: allocating %lli cells...\n", max_cells);
 			
-			cells = (struct cell *) calloc (max_cells, sizeof (struct cell));
+			if (use_arena == TRUE)
+			{
+				cells = Cells_alloc_cells_arena (max_cells, 0, reserve);
+			}
+			else
+			{
+				cells = (struct cell *) cells_calloc (max_cells, sizeof (struct cell));
+			}
 			if (cells == NULL)
 			{
 				printf ("fann_load_cells: ERROR: can't allocate %lli cells!\n", max_cells);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -418,20 +491,17 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 	else
 	{
 		printf ("fann_load_cells: error: no cells max number found!\n");
-		fclose (fptr);
 		return (NULL);
 	}
 	
 	while (file_eof == 0)
 	{
-		if (fgets_uni ((char *) buf, MAXLINELEN, fptr) == NULL)
+		if ((buf = load_line (fptr, line, line_max)) == NULL)
 		{
 			printf ("fann_load_cells: error reading data from file: %s\n", filename);
-			fclose (fptr);
 			return (NULL);
 		}
 		
-		str_cut_newline (buf);
 		
 		// printf ("ANNs load-line: '%s'\n", buf);
 		
@@ -439,6 +509,13 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 		{
 			// printf ("fann_load_cells: got EOF line, done reading! %s\n", filename);
 			file_eof = 1;
+			
+			// V0.2: the name table must be complete
+			if (names_saved >= 0 && names - 1 != names_saved)
+			{
+				printf ("fann_load_cells: error: %lli names, 'names' says %lli: %s\n", names - 1, names_saved, filename);
+				return (NULL);
+			}
 		}
 		
 		if (searchstr (buf, (U1 *) "cell =", 0, 0, 1) >= 0)
@@ -450,7 +527,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'cell' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -461,11 +537,17 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			{
 				cells[curr_cell].neurons_max = val;
 				
-				cells[curr_cell].neurons = (struct neuron *) calloc (val, sizeof (struct neuron));
+				cells[curr_cell].neurons = (struct neuron *) cell_calloc (cells, curr_cell, val, sizeof (struct neuron));
 				if (cells[curr_cell].neurons == NULL)
 				{
 					printf ("fann_load_cells: ERROR: can't allocate %lli neurons in cell %lli!\n", val, curr_cell);
-					fclose (fptr);
+					return (NULL);
+				}
+				
+				cells[curr_cell].cold = (struct neuron_cold *) cell_calloc (cells, curr_cell, val, sizeof (struct neuron_cold));
+				if (cells[curr_cell].cold == NULL)
+				{
+					printf ("fann_load_cells: ERROR: can't allocate %lli neurons names in cell %lli!\n", val, curr_cell);
 					return (NULL);
 				}
 				n = 0;
@@ -473,22 +555,75 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'neurons' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
 		
-		if (searchstr (buf, (U1 *) "fann_name =", 0, 0, 1) >= 0)
+		if (searchstr (buf, (U1 *) "names =", 0, 0, 1) >= 0)
+		{
+			if (get_number (buf, &val) == 0 && val >= 0)
+			{
+				names_saved = val;
+			}
+			else
+			{
+				printf ("fann_load_cells: error 'names' parsing file: %s\n", filename);
+				return (NULL);
+			}
+		}
+		
+		// the names have any length: no searchstr, it only reads MAXLINELEN
+		if (strncmp ((const char *) buf, "name_string = ", 14) == 0)
+		{
+			if (names_intern (cells, &buf[14], &name_id) == 0 && name_id == names)
+			{
+				names++;
+				continue;
+			}
+			else
+			{
+				printf ("fann_load_cells: error 'name_string' parsing file: %s\n", filename);
+				return (NULL);
+			}
+		}
+		
+		if (searchstr (buf, (U1 *) "fann_name_id =", 0, 0, 1) >= 0)
+		{
+			if (get_number (buf, &val) == 0 && val >= 0 && val < names)
+			{
+				names_set_node (cells, curr_cell, n, val);
+			}
+			else
+			{
+				printf ("fann_load_cells: error 'fann_name_id' parsing file: %s\n", filename);
+				return (NULL);
+			}
+		}
+		
+		if (searchstr (buf, (U1 *) "weights =", 0, 0, 1) >= 0)
+		{
+			if (get_number (buf, &val) == 0 && (val == WEIGHTS_F32 || val == WEIGHTS_F16 || val == WEIGHTS_BF16))
+			{
+				cells[curr_cell].cold[n].weights = val;
+			}
+			else
+			{
+				printf ("fann_load_cells: error 'weights' parsing file: %s\n", filename);
+				return (NULL);
+			}
+		}
+		
+		if (strncmp ((const char *) buf, "fann_name = ", 12) == 0)
 		{
-			if (get_string (buf, fann_name) == 0)
+			// V0.1 file
+			if (names_intern (cells, &buf[12], &cells[curr_cell].cold[n].fann_name) == 0)
 			{
-				strcpy ((char *) cells[curr_cell].neurons[n].fann_name, (const char *) fann_name);
-				// printf ("fann_name: '%s'\n", fann_name);
+				names_set_node (cells, curr_cell, n, cells[curr_cell].cold[n].fann_name);
+				continue;
 			}
 			else
 			{
 				printf ("fann_load_cells: error 'fann_name' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -502,7 +637,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'type' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -516,7 +650,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'inputs' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -530,7 +663,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'outputs' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -541,18 +673,16 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			{
 				cells[curr_cell].neurons[n].links_max = val;
 				
-				cells[curr_cell].neurons[n].links = calloc (val, sizeof (struct link));
+				cells[curr_cell].neurons[n].links = cell_calloc (cells, curr_cell, val, sizeof (struct link));
 				if (cells[curr_cell].neurons[n].links == NULL)
 				{
 					printf ("fann_load_cells: out of memory, allocating links!\n");
-					fclose (fptr);
 					return (NULL);
 				}
 			}
 			else
 			{
 				printf ("fann_load_cells: error 'links_max' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -566,7 +696,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 			else
 			{
 				printf ("fann_load_cells: error 'layer' parsing file: %s\n", filename);
-				fclose (fptr);
 				return (NULL);
 			}
 		}
@@ -583,10 +712,9 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 					
 				while (link_found_all == 0)
 				{
-					if (fgets_uni ((char *) buf, MAXLINELEN, fptr) == NULL)
+					if ((buf = load_line (fptr, line, line_max)) == NULL)
 					{
 						printf ("fann_load_cells: error reading data from file: %s\n", filename);
-						fclose (fptr);
 						return (NULL);
 					}
 						
@@ -602,7 +730,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 						else
 						{
 							printf ("fann_load_cells: error 'link_node' parsing file: %s\n", filename);
-							fclose (fptr);
 							return (NULL);
 						}
 					}
@@ -617,7 +744,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 						else
 						{
 							printf ("fann_load_cells: error 'link_node_input' parsing file: %s\n", filename);
-							fclose (fptr);
 							return (NULL);
 						}
 					}
@@ -632,7 +758,6 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 						else
 						{
 							printf ("fann_load_cells: error 'link_node_output' parsing file: %s\n", filename);
-							fclose (fptr);
 							return (NULL);
 						}
 					}
@@ -652,6 +777,45 @@ struct cell *Cells_fann_load_cells (U1 *filename)
 		}
 	}
 	
+	return (cells);
+}
+
+static struct cell *load_cells (U1 *filename, U1 use_arena, S8 reserve)
+{
+	struct cell *cells;
+	U1 *line;
+	S8 line_max = MAXLINELEN;
+	FILE *fptr;
+	
+	fptr = fopen ((const char *) filename, "r");
+	if (fptr == NULL)
+	{
+		printf ("fann_load_cells: error opening file: %s\n", filename);
+		return (NULL);
+	}
+	
+	// the line buffer grows for long ANN file names
+	line = (U1 *) cells_calloc (line_max, sizeof (U1));
+	if (line == NULL)
+	{
+		printf ("fann_load_cells: out of memory, allocating line buffer!\n");
+		fclose (fptr);
+		return (NULL);
+	}
+	
+	cells = load_cells_file (fptr, filename, use_arena, reserve, &line, &line_max);
+	cells_free (line);
 	fclose (fptr);
 	return (cells);
 }
+
+struct cell *Cells_fann_load_cells (U1 *filename)
+{
+	return (load_cells (filename, FALSE, 0));
+}
+
+struct cell *Cells_fann_load_cells_arena (U1 *filename, S8 reserve)
+{
+	// load cells into a new arena, free them with Cells_dealloc_cells_arena ()
+	return (load_cells (filename, TRUE, reserve));
+}
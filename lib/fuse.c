@@ -0,0 +1,754 @@
+/*
+ * This file fuse.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Fused node chains:
+ * Cells_set_fusion (cells, start_cell, end_cell, FUSION_CHAINS) lets the plan
+ * compiler merge chains of linked nodes into one native kernel. Node A and
+ * node B of a later layer are a chain if all links of A go to B, and every
+ * input of B is set by exactly one of them and by no other node. Chains can
+ * be longer: A -> B -> C ...
+ *
+ * The fused kernel has the layers of all nodes of the chain. The first layer
+ * of B gets the weights of its inputs added up at the outputs of A they are
+ * linked to, so it reads the last layer of A directly: the values between
+ * the nodes stay in the kernel buffer, there is no F8 conversion and no link
+ * copy. The nodes must have native float kernels (Cells_set_kernel), dense
+ * layers, no int8 calibration and no memo cache, else they are not fused.
+ *
+ * Cells_run_plan, Cells_run_plan_threads and Cells_run_cells_threads run a
+ * chain as a whole at the place of its last node, if all of its layers are in the layer range. The
+ * first node of a chain must not get links from nodes which run after it, so
+ * its inputs are the same there. The outputs of the last node and its links
+ * are the same as without fusion (up to KERNEL_TOLERANCE), the inputs and
+ * outputs of the other nodes of the chain are not set, they are marked
+ * PLAN_STALE: Cells_run_plan_dirty runs them again and copies their links.
+ * The other run functions still run the nodes one by one.
+ *
+ * Fused groups:
+ * With FUSION_GROUPS the nodes of a layer with the same shape (layers,
+ * activation functions and steepness, see kernel_same) are grouped, up to
+ * FUSION_GROUP_MAX nodes. A group kernel has the weights of its nodes side
+ * by side, so one vector instruction computes the same neuron of 8 nodes:
+ * this also fills the vectors for small nets. The group runs at its first
+ * node, the outputs are scattered to all nodes, and every node copies its
+ * links at its own place as before. The nodes of a group must not get links
+ * from nodes of the same or a later layer, and must not be in a chain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+
+void fuse_free (struct plan_fuse *fuse)
+{
+	S8 e;
+
+	if (fuse->kernel)
+	{
+		for (e = 0; e < fuse->entries_max; e++)
+		{
+			if (fuse->kernel[e]) kernel_free (fuse->kernel[e]);
+		}
+		cells_free (fuse->kernel);
+	}
+	if (fuse->groups)
+	{
+		for (e = 0; e < fuse->groups_max; e++)
+		{
+			if (fuse->groups[e].kernel) kernel_free (fuse->groups[e].kernel);
+			if (fuse->groups[e].entries) cells_free (fuse->groups[e].entries);
+			if (fuse->groups[e].inputs) cells_free (fuse->groups[e].inputs);
+		}
+		cells_free (fuse->groups);
+	}
+	if (fuse->group) cells_free (fuse->group);
+	if (fuse->head) cells_free (fuse->head);
+	if (fuse->tail) cells_free (fuse->tail);
+	if (fuse->next) cells_free (fuse->next);
+	cells_free (fuse);
+}
+
+void fuse_clone_free (struct plan_fuse *clone)
+{
+	// only the kernels and group inputs belong to the clone
+	S8 e;
+
+	if (clone->kernel)
+	{
+		for (e = 0; e < clone->entries_max; e++)
+		{
+			if (clone->kernel[e]) kernel_free (clone->kernel[e]);
+		}
+		cells_free (clone->kernel);
+	}
+	if (clone->groups)
+	{
+		for (e = 0; e < clone->groups_max; e++)
+		{
+			if (clone->groups[e].kernel) kernel_free (clone->groups[e].kernel);
+			if (clone->groups[e].inputs) cells_free (clone->groups[e].inputs);
+		}
+		cells_free (clone->groups);
+	}
+	cells_free (clone);
+}
+
+S2 fuse_clone (struct plan_fuse *fuse, struct plan *plan, struct plan_fuse **clone_ret)
+{
+	// fusion of a run context plan: own kernels, the group inputs of the plan, the rest is shared
+	struct plan_fuse *clone;
+	struct plan_group *group;
+	S8 e, g, k;
+
+	*clone_ret = NULL;
+	clone = (struct plan_fuse *) cells_calloc (1, sizeof (struct plan_fuse));
+	if (clone == NULL)
+	{
+		return (1);
+	}
+
+	*clone = *fuse;
+	clone->kernel = (struct kernel **) cells_calloc (fuse->entries_max + 1, sizeof (struct kernel *));
+	clone->groups = (struct plan_group *) cells_calloc (fuse->groups_max + 1, sizeof (struct plan_group));
+	if (clone->kernel == NULL || clone->groups == NULL)
+	{
+		fuse_clone_free (clone);
+		return (1);
+	}
+
+	for (e = 0; e < fuse->entries_max; e++)
+	{
+		if (fuse->kernel[e] != NULL && kernel_clone (fuse->kernel[e], &clone->kernel[e]) != 0)
+		{
+			fuse_clone_free (clone);
+			return (1);
+		}
+	}
+
+	for (g = 0; g < fuse->groups_max; g++)
+	{
+		group = &clone->groups[g];
+		*group = fuse->groups[g];
+		group->kernel = NULL;
+		group->inputs = (fann_type **) cells_calloc (FUSION_GROUP_MAX, sizeof (fann_type *));
+		if (group->inputs == NULL || kernel_clone (fuse->groups[g].kernel, &group->kernel) != 0)
+		{
+			fuse_clone_free (clone);
+			return (1);
+		}
+
+		for (k = 0; k < group->entries_max; k++)
+		{
+			group->inputs[k] = plan->inputs_f[group->entries[k]];
+		}
+	}
+
+	*clone_ret = clone;
+	return (0);
+}
+
+static S8 fuse_next (struct plan *plan, S8 e, S8 *incoming, S8 *mark)
+{
+	// the entry all links of e go to 1:1, -1 = none
+	struct plan_entry *entry;
+	struct plan_link *link;
+	S8 j, f;
+
+	entry = &plan->entries[e];
+	if (entry->link_start == entry->link_end)
+	{
+		return (-1);
+	}
+
+	f = plan->links[entry->link_start].node;
+	if (plan->entries[f].layer <= entry->layer || entry->link_end - entry->link_start != plan->inputs[f] || incoming[f] != plan->inputs[f])
+	{
+		return (-1);
+	}
+
+	for (j = entry->link_start; j < entry->link_end; j++)
+	{
+		link = &plan->links[j];
+		if (link->node != f || mark[link->node_input] == e + 1)
+		{
+			return (-1);
+		}
+		mark[link->node_input] = e + 1;
+	}
+	return (f);
+}
+
+static U1 fuse_entry (struct plan *plan, S8 e)
+{
+	if (plan->kernel[e] == NULL || plan->memo[e] != NULL || kernel_fusable (plan->kernel[e]) == FALSE)
+	{
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+static S2 fuse_chain (struct plan *plan, struct plan_fuse *fuse, S8 head, S8 members)
+{
+	// fuse the chain starting at head, with members nodes
+	struct kernel **kernels;
+	struct plan_link *link;
+	S8 **maps;
+	S8 k, j, e;
+	S2 ret = 0;
+
+	kernels = (struct kernel **) cells_calloc (members, sizeof (struct kernel *));
+	maps = (S8 **) cells_calloc (members, sizeof (S8 *));
+	if (kernels == NULL || maps == NULL)
+	{
+		ret = 1;
+		goto fuse_chain_end;
+	}
+
+	e = head;
+	for (k = 0; k < members; k++)
+	{
+		kernels[k] = plan->kernel[e];
+		if (k < members - 1)
+		{
+			// inputs of the next node: the output linked to it
+			maps[k + 1] = (S8 *) cells_calloc (plan->inputs[fuse->next[e]], sizeof (S8));
+			if (maps[k + 1] == NULL)
+			{
+				ret = 1;
+				goto fuse_chain_end;
+			}
+			for (j = plan->entries[e].link_start; j < plan->entries[e].link_end; j++)
+			{
+				link = &plan->links[j];
+				maps[k + 1][link->node_input] = link->node_output;
+			}
+		}
+		fuse->head[e] = head;
+		fuse->tail[head] = e;
+		e = fuse->next[e];
+	}
+
+	if (kernel_fuse (kernels, members, maps, &fuse->kernel[head]) != 0)
+	{
+		ret = 1;
+		goto fuse_chain_end;
+	}
+
+	if (fuse->kernel[head] == NULL)
+	{
+		// too many layers: the nodes run one by one
+		for (e = head; e != fuse->tail[head]; e = fuse->next[e])
+		{
+			fuse->head[e] = -1;
+		}
+		fuse->head[e] = -1;
+		goto fuse_chain_end;
+	}
+
+	fuse->chains_max++;
+	fuse->nodes_max += members;
+
+fuse_chain_end:
+	if (maps)
+	{
+		for (k = 0; k < members; k++)
+		{
+			if (maps[k]) cells_free (maps[k]);
+		}
+		cells_free (maps);
+	}
+	if (kernels) cells_free (kernels);
+	return (ret);
+}
+
+static S2 fuse_groups (struct plan *plan, struct plan_fuse *fuse, U1 *layer_late)
+{
+	// group the nodes of every layer with the same shape
+	struct plan_group *group;
+	struct kernel **kernels;
+	S8 l, e, f, g;
+
+	kernels = (struct kernel **) cells_calloc (FUSION_GROUP_MAX, sizeof (struct kernel *));
+	if (kernels == NULL)
+	{
+		return (1);
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		fuse->group[e] = -1;
+		if (fuse_entry (plan, e) == FALSE || fuse->head[e] >= 0 || layer_late[e] == TRUE)
+		{
+			// not in a group: marked as done
+			fuse->group[e] = -2;
+		}
+	}
+
+	for (l = 0; l < plan->layers_max; l++)
+	{
+		for (e = plan->layers[l].entry_start; e < plan->layers[l].entry_end; e++)
+		{
+			if (fuse->group[e] != -1)
+			{
+				continue;
+			}
+
+			group = &fuse->groups[fuse->groups_max];
+			group->entries = (S8 *) cells_calloc (FUSION_GROUP_MAX, sizeof (S8));
+			group->inputs = (fann_type **) cells_calloc (FUSION_GROUP_MAX, sizeof (fann_type *));
+			if (group->entries == NULL || group->inputs == NULL)
+			{
+				cells_free (kernels);
+				return (1);
+			}
+			fuse->groups_max++;
+
+			for (f = e; f < plan->layers[l].entry_end && group->entries_max < FUSION_GROUP_MAX; f++)
+			{
+				if (fuse->group[f] == -1 && kernel_same (plan->kernel[e], plan->kernel[f]) == TRUE)
+				{
+					kernels[group->entries_max] = plan->kernel[f];
+					group->inputs[group->entries_max] = plan->inputs_f[f];
+					group->entries[group->entries_max] = f;
+					group->entries_max++;
+					fuse->group[f] = fuse->groups_max - 1;
+				}
+			}
+
+			if (group->entries_max < 2)
+			{
+				// a node alone runs with its own kernel
+				fuse->group[e] = -2;
+				continue;
+			}
+
+			if (kernel_group (kernels, group->entries_max, &group->kernel) != 0)
+			{
+				cells_free (kernels);
+				return (1);
+			}
+			fuse->group_nodes_max += group->entries_max;
+		}
+	}
+
+	// groups with one node are not run
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		g = fuse->group[e];
+		if (g < 0 || fuse->groups[g].kernel == NULL)
+		{
+			fuse->group[e] = -1;
+		}
+	}
+
+	cells_free (kernels);
+	return (0);
+}
+
+S2 fuse_plan (struct plan *plan, U1 fusion)
+{
+	// find and fuse the chains and groups of a new plan
+	struct plan_fuse *fuse;
+	S8 *incoming;
+	S8 *mark;
+	S8 *prev;
+	U1 *late;
+	U1 *layer_late;
+	S8 e, f, j, head, members, inputs_max = 0;
+	S2 ret = 0;
+
+	fuse = (struct plan_fuse *) cells_calloc (1, sizeof (struct plan_fuse));
+	if (fuse == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating fusion!\n");
+		return (1);
+	}
+	fuse->entries_max = plan->entries_max;
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		if (plan->inputs[e] > inputs_max) inputs_max = plan->inputs[e];
+	}
+
+	fuse->head = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	fuse->tail = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	fuse->next = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	fuse->kernel = (struct kernel **) cells_calloc (plan->entries_max + 1, sizeof (struct kernel *));
+	incoming = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	prev = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	late = (U1 *) cells_calloc (plan->entries_max + 1, sizeof (U1));
+	layer_late = (U1 *) cells_calloc (plan->entries_max + 1, sizeof (U1));
+	mark = (S8 *) cells_calloc (inputs_max + 1, sizeof (S8));
+	fuse->group = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	fuse->groups = (struct plan_group *) cells_calloc (plan->entries_max + 1, sizeof (struct plan_group));
+	if (fuse->head == NULL || fuse->tail == NULL || fuse->next == NULL || fuse->kernel == NULL || fuse->group == NULL || fuse->groups == NULL
+		|| incoming == NULL || prev == NULL || late == NULL || layer_late == NULL || mark == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating fusion!\n");
+		fuse_free (fuse);
+		ret = 1;
+		goto fuse_plan_end;
+	}
+
+	for (j = 0; j < plan->links_max; j++)
+	{
+		incoming[plan->links[j].node]++;
+	}
+
+	// late: gets a link from itself or from an entry after it
+	// layer_late: gets a link from an entry of the same or a later layer
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		for (j = plan->entries[e].link_start; j < plan->entries[e].link_end; j++)
+		{
+			f = plan->links[j].node;
+			if (f <= e)
+			{
+				late[f] = TRUE;
+			}
+			if (plan->entries[f].layer <= plan->entries[e].layer)
+			{
+				layer_late[f] = TRUE;
+			}
+		}
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		fuse->head[e] = -1;
+		fuse->group[e] = -1;
+		prev[e] = -1;
+	}
+
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		fuse->next[e] = -1;
+		if ((fusion & FUSION_CHAINS) == 0 || fuse_entry (plan, e) == FALSE)
+		{
+			continue;
+		}
+
+		f = fuse_next (plan, e, incoming, mark);
+		if (f >= 0 && fuse_entry (plan, f) == TRUE)
+		{
+			fuse->next[e] = f;
+			prev[f] = e;
+		}
+	}
+
+	// a chain starts at a node which is not the next of another one
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		if (fuse->next[e] < 0 || prev[e] >= 0)
+		{
+			continue;
+		}
+
+		// a late first node runs alone, the chain starts at the next one
+		head = late[e] == TRUE ? fuse->next[e] : e;
+		if (fuse->next[head] < 0)
+		{
+			continue;
+		}
+
+		members = 1;
+		for (f = fuse->next[head]; f >= 0; f = fuse->next[f])
+		{
+			members++;
+		}
+
+		if (fuse_chain (plan, fuse, head, members) != 0)
+		{
+			printf ("compile_plan: out of memory, allocating fused kernel!\n");
+			fuse_free (fuse);
+			ret = 1;
+			goto fuse_plan_end;
+		}
+	}
+
+	if ((fusion & FUSION_GROUPS) != 0 && fuse_groups (plan, fuse, layer_late) != 0)
+	{
+		printf ("compile_plan: out of memory, allocating group kernel!\n");
+		fuse_free (fuse);
+		ret = 1;
+		goto fuse_plan_end;
+	}
+
+	plan->fuse = fuse;
+
+fuse_plan_end:
+	if (incoming) cells_free (incoming);
+	if (prev) cells_free (prev);
+	if (late) cells_free (late);
+	if (layer_late) cells_free (layer_late);
+	if (mark) cells_free (mark);
+	return (ret);
+}
+
+U1 fuse_whole (struct plan *plan, S8 e, S8 start_layer, S8 end_layer)
+{
+	// TRUE: e is in a chain which runs as a whole in the layer range
+	S8 head;
+
+	if (plan->fuse == NULL || plan->fuse->head[e] < 0)
+	{
+		return (FALSE);
+	}
+
+	head = plan->fuse->head[e];
+	if (plan->entries[head].layer < start_layer || plan->entries[plan->fuse->tail[head]].layer > end_layer)
+	{
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+U1 fuse_inner (struct plan *plan, S8 e, S8 start_layer, S8 end_layer)
+{
+	// TRUE: e is in a chain which runs as a whole, but is not its last node
+	if (fuse_whole (plan, e, start_layer, end_layer) == FALSE)
+	{
+		return (FALSE);
+	}
+	return (plan->fuse->tail[plan->fuse->head[e]] != e);
+}
+
+void fuse_run (struct plan *plan, S8 head)
+{
+	// run the fused kernel of a chain: head inputs to the outputs of the last node
+	fann_type *input_f;
+	fann_type *output_f;
+	F8 *input_nodef;
+	F8 *output_nodef;
+	S8 i, e, tail;
+
+	tail = plan->fuse->tail[head];
+	input_f = plan->inputs_f[head];
+
+	if (plan->storage == STORAGE_FANN)
+	{
+		output_f = kernel_run (plan->fuse->kernel[head], plan->ann[head], input_f);
+		memcpy (plan->outputs_f[tail], output_f, plan->outputs[tail] * sizeof (fann_type));
+	}
+	else
+	{
+		input_nodef = plan->inputs_nodef[head];
+		for (i = 0; i < plan->inputs[head]; i++)
+		{
+			input_f[i] = input_nodef[i];
+		}
+
+		output_f = kernel_run (plan->fuse->kernel[head], plan->ann[head], input_f);
+
+		output_nodef = plan->outputs_nodef[tail];
+		for (i = 0; i < plan->outputs[tail]; i++)
+		{
+			output_nodef[i] = output_f[i];
+		}
+	}
+
+	// the outputs of the inner nodes are old: a dirty run must take them as changed
+	for (e = head; e != tail; e = plan->fuse->next[e])
+	{
+		plan->dirty[e] = PLAN_STALE;
+	}
+	plan->dirty[tail] = 0;
+}
+
+static void fuse_group_run (struct plan *plan, struct plan_group *group)
+{
+	// run the group kernel and scatter the outputs to the nodes
+	fann_type *input_f;
+	fann_type *output_f;
+	F8 *input_nodef;
+	F8 *output_nodef;
+	S8 lanes, g, e, i;
+
+	if (plan->storage == STORAGE_F8)
+	{
+		for (g = 0; g < group->entries_max; g++)
+		{
+			e = group->entries[g];
+			input_f = plan->inputs_f[e];
+			input_nodef = plan->inputs_nodef[e];
+			for (i = 0; i < plan->inputs[e]; i++)
+			{
+				input_f[i] = input_nodef[i];
+			}
+		}
+	}
+
+	output_f = kernel_group_run (group->kernel, group->inputs, group->entries_max);
+	lanes = kernel_group_lanes (group->kernel);
+
+	for (g = 0; g < group->entries_max; g++)
+	{
+		e = group->entries[g];
+		plan->dirty[e] = 0;
+
+		if (plan->storage == STORAGE_FANN)
+		{
+			for (i = 0; i < plan->outputs[e]; i++)
+			{
+				plan->outputs_f[e][i] = output_f[i * lanes + g];
+			}
+			continue;
+		}
+
+		output_nodef = plan->outputs_nodef[e];
+		for (i = 0; i < plan->outputs[e]; i++)
+		{
+			output_nodef[i] = output_f[i * lanes + g];
+		}
+	}
+}
+
+U1 fuse_grouped (struct plan *plan, S8 e)
+{
+	// TRUE: e is in a group, which runs at its first node
+	struct plan_group *group;
+
+	if (plan->fuse == NULL || plan->fuse->group[e] < 0)
+	{
+		return (FALSE);
+	}
+
+	group = &plan->fuse->groups[plan->fuse->group[e]];
+	if (group->entries[0] == e)
+	{
+		fuse_group_run (plan, group);
+	}
+	return (TRUE);
+}
+
+struct kernel *fuse_kernel (struct plan *plan, S8 e)
+{
+	// kernel which runs at plan entry e in a whole run, NULL = none
+	struct plan_group *group;
+	S8 head;
+
+	if (plan->fuse == NULL)
+	{
+		return (plan->kernel[e]);
+	}
+
+	head = plan->fuse->head[e];
+	if (head >= 0)
+	{
+		return (plan->fuse->tail[head] == e ? plan->fuse->kernel[head] : NULL);
+	}
+
+	if (plan->fuse->group[e] >= 0)
+	{
+		group = &plan->fuse->groups[plan->fuse->group[e]];
+		return (group->entries[0] == e ? group->kernel : NULL);
+	}
+	return (plan->kernel[e]);
+}
+
+S2 Cells_set_fusion (struct cell *cells, S8 start_cell, S8 end_cell, U1 fusion)
+{
+	// FUSION_NONE: run every node, FUSION_CHAINS, FUSION_GROUPS and/or FUSION_LINKS: fuse linked chains, same-shape nodes, alias links
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("set_fusion: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if ((fusion & ~(FUSION_CHAINS | FUSION_GROUPS | FUSION_LINKS)) != 0)
+	{
+		printf ("set_fusion: error: unknown fusion: %i!\n", fusion);
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		cells[i].fusion = fusion;
+		cells[i].topology++;
+	}
+	return (0);
+}
+
+S2 Cells_fusion_chains (struct cell *cells, S8 cell, S8 *chains, S8 *nodes)
+{
+	// fused chains of a cell and the nodes in them
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("fusion_chains: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (plan_check (cells, cell) != 0)
+	{
+		printf ("fusion_chains: error compiling cell: %lli!\n", cell);
+		return (1);
+	}
+
+	*chains = 0;
+	*nodes = 0;
+	if (cells[cell].plan->fuse != NULL)
+	{
+		*chains = cells[cell].plan->fuse->chains_max;
+		*nodes = cells[cell].plan->fuse->nodes_max;
+	}
+	return (0);
+}
+
+S2 Cells_fusion_groups (struct cell *cells, S8 cell, S8 *groups, S8 *nodes)
+{
+	// fused groups of a cell and the nodes in them
+	S8 g;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("fusion_groups: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (plan_check (cells, cell) != 0)
+	{
+		printf ("fusion_groups: error compiling cell: %lli!\n", cell);
+		return (1);
+	}
+
+	*groups = 0;
+	*nodes = 0;
+	if (cells[cell].plan->fuse != NULL)
+	{
+		for (g = 0; g < cells[cell].plan->fuse->groups_max; g++)
+		{
+			if (cells[cell].plan->fuse->groups[g].kernel != NULL)
+			{
+				(*groups)++;
+			}
+		}
+		*nodes = cells[cell].plan->fuse->group_nodes_max;
+	}
+	return (0);
+}
@@ -0,0 +1,2122 @@
+/*
+ * This file kernel.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Native kernel:
+ * For FANN networks of network type LAYER the weights are packed into aligned row-major blocks, one row per neuron
+ * with the bias weight at the end of the inputs, padded to KERNEL_PAD values.
+ * A layer is then a matrix-vector product and the activation functions, the
+ * same as in fann_run. The dot products are done with AVX-512 or AVX2/FMA
+ * if the CPU has it, else with the scalar C code.
+ *
+ * Cells_set_kernel (cells, start_cell, end_cell, KERNEL_NATIVE) builds the
+ * kernels of all ANN nodes, and Cells_fann_read_ann builds them for new ANNs.
+ * Networks with other connections, or with the stepwise activation functions,
+ * have no kernel and still run with fann_run. Tiny 3 layer nets of common
+ * shapes get a kernel made for their shape, see "tiny nets" below.
+ *
+ * Layers of partially connected nets (fann_create_sparse) or with pruned
+ * weights are stored as compressed rows (CSR) if less than the sparse density
+ * (Cells_kernel_set_sparse) of their weights are not zero: per neuron only the
+ * weights of its connections, with the input numbers. The dot products then
+ * only read these inputs, with AVX2 gathers if the CPU has them.
+ *
+ * The sums are added in another order than in fann_run, so the outputs are
+ * not bit-identical: the difference is at most KERNEL_TOLERANCE for outputs
+ * up to 1.0 (relative to the output above 1.0). Cells_kernel_verify compares
+ * a kernel with fann_run, Cells_kernel_selftest does this for nets with all
+ * supported activation functions, on all instruction sets of the CPU.
+ * With fast math (see fast.c) the sigmoid functions are taken from a table.
+ * A calibrated kernel runs its layers with int8 weights, see quant.c.
+ *
+ * Cells_set_node_weights stores the weights of a node kernel as IEEE half
+ * (WEIGHTS_F16) or bfloat16 (WEIGHTS_BF16) instead of float: half the bytes
+ * to read for big nets. The dot products widen them to float with F16C or
+ * AVX-512, else in C. The error against fann_run is bigger then, and
+ * depends on the weights: Cells_kernel_verify only returns it.
+ *
+ * Fused kernels for fuse.c: kernel_fuse puts the layers of a chain of nodes
+ * into one kernel, kernel_group runs nodes of the same shape side by side.
+ * Cells_pack_weights moves the layer arrays of the kernels into one weight
+ * slab, see slab.c. kernel_clone makes a kernel for a run context (see
+ * context.c): it shares the layers and has its own run buffers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86 1
+#endif
+
+#include "cells-internal.h"
+
+#define KERNEL_PAD 16			// row padding: one AVX-512 vector of floats
+#define KERNEL_LAYERS_MAX 64
+#define KERNEL_LANES 8			// group kernel: nodes per AVX2 vector
+#define KERNEL_PREFETCH 2048	// bytes of the next kernel to prefetch from the slab
+#define KERNEL_GRID 8			// selftest of threshold nets: weights and inputs in steps of 1 / 8
+
+typedef void (*kernel_layer_func) (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums);
+typedef void (*kernel_half_func) (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums);
+typedef void (*kernel_sparse_func) (const S4 *row_start, const S4 *col_index, const fann_type *values, const fann_type *x, S8 rows, fann_type *sums);
+typedef void (*kernel_group_func) (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, S8 lanes, fann_type *sums);
+typedef fann_type *(*kernel_tiny_func) (struct kernel *kernel, fann_type *input);
+
+struct kernel_layer
+{
+	S8 inputs;				// without bias
+	S8 outputs;
+	S8 cols;				// row length: inputs + bias, padded
+	fann_type *weights;		// outputs rows of cols, NULL = 16 bit or sparse weights
+	U2 *half;				// WEIGHTS_F16 or WEIGHTS_BF16: outputs rows of cols
+	S4 *row_start;			// sparse: outputs + 1 starts in values, NULL = dense
+	S4 *col_index;			// sparse: input of the value, inputs = bias
+	fann_type *values;		// sparse: weights of the connections
+	U1 *activation;			// per neuron
+	fann_type *steepness;	// per neuron
+};
+
+struct kernel
+{
+	S8 layers_max;
+	struct kernel_layer *layers;
+	U1 weights;				// WEIGHTS_F32, WEIGHTS_F16 or WEIGHTS_BF16
+	S8 cols_max;
+	fann_type *x;			// layer inputs, with bias and padding
+	fann_type *sums;
+	fann_type *output;
+	struct fast *fast;		// activation table, NULL = exact, see fast.c
+	struct quant *quant;	// int8 layers, NULL = float, see quant.c
+	S8 lanes;				// group kernel: nodes side by side, 0 = one node
+	struct slab *slab;		// slab of the layer arrays, NULL = each on the heap
+	U1 *slab_start;
+	S8 slab_bytes;
+	U1 clone;				// TRUE: the layers belong to another kernel, see kernel_clone
+	S8 tiny_size;			// bytes of the tiny weights
+
+	// tiny nets: kernel of the shape, with the weights after the kernel structure
+	kernel_tiny_func tiny;	// NULL = run the layers
+	U1 tiny_activation[2];	// hidden and output layer
+	fann_type tiny_steepness[2];
+	fann_type tiny_weights[] __attribute__ ((aligned (CELLS_ALIGN)));
+};
+
+static U1 kernel_isa = KERNEL_ISA_SCALAR;
+static U1 kernel_isa_max = KERNEL_ISA_SCALAR;
+static U1 kernel_isa_init = FALSE;
+static kernel_layer_func kernel_layer;
+static kernel_half_func kernel_layer_f16;
+static kernel_half_func kernel_layer_bf16;
+static kernel_sparse_func kernel_layer_sparse;
+static kernel_group_func kernel_layer_group;
+static F8 kernel_sparse_density = KERNEL_SPARSE_DENSITY;
+
+
+// dot products:
+
+static void layer_scalar (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	S8 r, c;
+	fann_type sum0, sum1, sum2, sum3;
+
+	for (r = 0; r < rows; r++)
+	{
+		sum0 = 0; sum1 = 0; sum2 = 0; sum3 = 0;
+		for (c = 0; c < cols; c += 4)
+		{
+			sum0 += weights[c] * x[c];
+			sum1 += weights[c + 1] * x[c + 1];
+			sum2 += weights[c + 2] * x[c + 2];
+			sum3 += weights[c + 3] * x[c + 3];
+		}
+		sums[r] = (sum0 + sum1) + (sum2 + sum3);
+		weights += cols;
+	}
+}
+
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+__attribute__ ((target ("avx2,fma")))
+static void layer_avx2 (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m256 acc0, acc1;
+	__m128 low, high;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc0 = _mm256_setzero_ps ();
+		acc1 = _mm256_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			acc0 = _mm256_fmadd_ps (_mm256_load_ps (&weights[c]), _mm256_load_ps (&x[c]), acc0);
+			acc1 = _mm256_fmadd_ps (_mm256_load_ps (&weights[c + 8]), _mm256_load_ps (&x[c + 8]), acc1);
+		}
+		acc0 = _mm256_add_ps (acc0, acc1);
+
+		// horizontal sum
+		low = _mm_add_ps (_mm256_castps256_ps128 (acc0), _mm256_extractf128_ps (acc0, 1));
+		high = _mm_movehl_ps (low, low);
+		low = _mm_add_ps (low, high);
+		high = _mm_shuffle_ps (low, low, 0x55);
+		sums[r] = _mm_cvtss_f32 (_mm_add_ss (low, high));
+		weights += cols;
+	}
+}
+
+__attribute__ ((target ("avx512f")))
+static void layer_avx512 (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m512 acc;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc = _mm512_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			acc = _mm512_fmadd_ps (_mm512_load_ps (&weights[c]), _mm512_load_ps (&x[c]), acc);
+		}
+		sums[r] = _mm512_reduce_add_ps (acc);
+		weights += cols;
+	}
+}
+#endif
+
+// 16 bit weights: converted when the kernel is built, widened to float in the dot products
+
+static U2 float_to_f16 (fann_type value)
+{
+	// IEEE half, round to nearest even, saturated to the biggest half
+	union { float f; U4 u; } bits;
+	U4 sign, mant, rest, half;
+	S4 exp;
+
+	bits.f = (float) value;
+	sign = (bits.u >> 16) & 0x8000;
+	exp = (S4) ((bits.u >> 23) & 0xff) - 127 + 15;
+	mant = bits.u & 0x7fffff;
+
+	if (((bits.u >> 23) & 0xff) == 0xff)
+	{
+		// inf or NaN
+		return ((U2) (sign | 0x7c00 | (mant != 0 ? 0x200 : 0)));
+	}
+
+	if (exp <= 0)
+	{
+		// subnormal half, or zero
+		if (exp < -10)
+		{
+			return ((U2) sign);
+		}
+		mant |= 0x800000;
+		half = mant >> (14 - exp);
+		rest = mant & ((1U << (14 - exp)) - 1);
+		if (rest > (1U << (13 - exp)) || (rest == (1U << (13 - exp)) && (half & 1)))
+		{
+			half++;
+		}
+		return ((U2) (sign | half));
+	}
+
+	half = ((U4) exp << 10) | (mant >> 13);
+	rest = mant & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	if (exp >= 31 || half >= 0x7c00)
+	{
+		half = 0x7bff;
+	}
+	return ((U2) (sign | half));
+}
+
+static fann_type f16_to_float (U2 half)
+{
+	union { float f; U4 u; } bits;
+	U4 exp, mant;
+
+	exp = (half >> 10) & 0x1f;
+	mant = half & 0x3ff;
+
+	if (exp == 0)
+	{
+		// subnormal: mant * 2^-24
+		bits.f = (float) mant / 16777216.0f;
+		bits.u |= (U4) (half & 0x8000) << 16;
+		return (bits.f);
+	}
+
+	if (exp == 31)
+	{
+		bits.u = ((U4) (half & 0x8000) << 16) | 0x7f800000 | (mant << 13);
+		return (bits.f);
+	}
+
+	bits.u = ((U4) (half & 0x8000) << 16) | ((exp - 15 + 127) << 23) | (mant << 13);
+	return (bits.f);
+}
+
+static U2 float_to_bf16 (fann_type value)
+{
+	// upper half of the float, round to nearest even
+	union { float f; U4 u; } bits;
+
+	bits.f = (float) value;
+	if ((bits.u & 0x7f800000) == 0x7f800000 && (bits.u & 0x7fffff) != 0)
+	{
+		return ((U2) ((bits.u >> 16) | 0x40));
+	}
+	return ((U2) ((bits.u + 0x7fff + ((bits.u >> 16) & 1)) >> 16));
+}
+
+static fann_type bf16_to_float (U2 half)
+{
+	union { float f; U4 u; } bits;
+
+	bits.u = (U4) half << 16;
+	return (bits.f);
+}
+
+static void layer_f16_scalar (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	S8 r, c;
+	fann_type sum;
+
+	for (r = 0; r < rows; r++)
+	{
+		sum = 0;
+		for (c = 0; c < cols; c++)
+		{
+			sum += f16_to_float (weights[c]) * x[c];
+		}
+		sums[r] = sum;
+		weights += cols;
+	}
+}
+
+static void layer_bf16_scalar (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	S8 r, c;
+	fann_type sum;
+
+	for (r = 0; r < rows; r++)
+	{
+		sum = 0;
+		for (c = 0; c < cols; c++)
+		{
+			sum += bf16_to_float (weights[c]) * x[c];
+		}
+		sums[r] = sum;
+		weights += cols;
+	}
+}
+
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+__attribute__ ((target ("avx2,fma,f16c")))
+static inline fann_type hsum_avx2 (__m256 acc)
+{
+	__m128 low, high;
+
+	low = _mm_add_ps (_mm256_castps256_ps128 (acc), _mm256_extractf128_ps (acc, 1));
+	high = _mm_movehl_ps (low, low);
+	low = _mm_add_ps (low, high);
+	high = _mm_shuffle_ps (low, low, 0x55);
+	return (_mm_cvtss_f32 (_mm_add_ss (low, high)));
+}
+
+__attribute__ ((target ("avx2,fma,f16c")))
+static void layer_f16_avx2 (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m256 acc0, acc1;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc0 = _mm256_setzero_ps ();
+		acc1 = _mm256_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			acc0 = _mm256_fmadd_ps (_mm256_cvtph_ps (_mm_load_si128 ((const __m128i *) &weights[c])), _mm256_load_ps (&x[c]), acc0);
+			acc1 = _mm256_fmadd_ps (_mm256_cvtph_ps (_mm_load_si128 ((const __m128i *) &weights[c + 8])), _mm256_load_ps (&x[c + 8]), acc1);
+		}
+		sums[r] = hsum_avx2 (_mm256_add_ps (acc0, acc1));
+		weights += cols;
+	}
+}
+
+__attribute__ ((target ("avx2,fma,f16c")))
+static inline __m256 bf16_avx2 (const U2 *weights)
+{
+	// bf16 is the upper half of the float
+	__m256i wide;
+
+	wide = _mm256_cvtepu16_epi32 (_mm_load_si128 ((const __m128i *) weights));
+	return (_mm256_castsi256_ps (_mm256_slli_epi32 (wide, 16)));
+}
+
+__attribute__ ((target ("avx2,fma,f16c")))
+static void layer_bf16_avx2 (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m256 acc0, acc1;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc0 = _mm256_setzero_ps ();
+		acc1 = _mm256_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			acc0 = _mm256_fmadd_ps (bf16_avx2 (&weights[c]), _mm256_load_ps (&x[c]), acc0);
+			acc1 = _mm256_fmadd_ps (bf16_avx2 (&weights[c + 8]), _mm256_load_ps (&x[c + 8]), acc1);
+		}
+		sums[r] = hsum_avx2 (_mm256_add_ps (acc0, acc1));
+		weights += cols;
+	}
+}
+
+__attribute__ ((target ("avx512f")))
+static void layer_f16_avx512 (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m512 acc;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc = _mm512_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			acc = _mm512_fmadd_ps (_mm512_cvtph_ps (_mm256_load_si256 ((const __m256i *) &weights[c])), _mm512_load_ps (&x[c]), acc);
+		}
+		sums[r] = _mm512_reduce_add_ps (acc);
+		weights += cols;
+	}
+}
+
+__attribute__ ((target ("avx512f")))
+static void layer_bf16_avx512 (const U2 *weights, const fann_type *x, S8 rows, S8 cols, fann_type *sums)
+{
+	__m512i wide;
+	__m512 acc;
+	S8 r, c;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc = _mm512_setzero_ps ();
+		for (c = 0; c < cols; c += 16)
+		{
+			wide = _mm512_slli_epi32 (_mm512_cvtepu16_epi32 (_mm256_load_si256 ((const __m256i *) &weights[c])), 16);
+			acc = _mm512_fmadd_ps (_mm512_castsi512_ps (wide), _mm512_load_ps (&x[c]), acc);
+		}
+		sums[r] = _mm512_reduce_add_ps (acc);
+		weights += cols;
+	}
+}
+#endif
+
+
+// sparse dot products:
+
+static void layer_sparse_scalar (const S4 *row_start, const S4 *col_index, const fann_type *values, const fann_type *x, S8 rows, fann_type *sums)
+{
+	S8 r, k, end;
+	fann_type sum0, sum1;
+
+	for (r = 0; r < rows; r++)
+	{
+		sum0 = 0; sum1 = 0;
+		end = row_start[r + 1];
+		for (k = row_start[r]; k + 1 < end; k += 2)
+		{
+			sum0 += values[k] * x[col_index[k]];
+			sum1 += values[k + 1] * x[col_index[k + 1]];
+		}
+		if (k < end)
+		{
+			sum0 += values[k] * x[col_index[k]];
+		}
+		sums[r] = sum0 + sum1;
+	}
+}
+
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+__attribute__ ((target ("avx2,fma,f16c")))
+static void layer_sparse_avx2 (const S4 *row_start, const S4 *col_index, const fann_type *values, const fann_type *x, S8 rows, fann_type *sums)
+{
+	__m256 acc;
+	S8 r, k, end;
+	fann_type sum;
+
+	for (r = 0; r < rows; r++)
+	{
+		acc = _mm256_setzero_ps ();
+		end = row_start[r + 1];
+		for (k = row_start[r]; k + 8 <= end; k += 8)
+		{
+			acc = _mm256_fmadd_ps (_mm256_loadu_ps (&values[k]),
+				_mm256_i32gather_ps (x, _mm256_loadu_si256 ((const __m256i *) &col_index[k]), sizeof (fann_type)), acc);
+		}
+		sum = hsum_avx2 (acc);
+		for (; k < end; k++)
+		{
+			sum += values[k] * x[col_index[k]];
+		}
+		sums[r] = sum;
+	}
+}
+#endif
+
+
+// group dot products: lanes nodes side by side, weights and x [row or col][lanes]
+
+static void layer_group_scalar (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, S8 lanes, fann_type *sums)
+{
+	S8 r, c, g;
+	const fann_type *w;
+	const fann_type *xc;
+
+	for (r = 0; r < rows; r++)
+	{
+		for (g = 0; g < lanes; g++)
+		{
+			sums[g] = 0;
+		}
+		for (c = 0; c < cols; c++)
+		{
+			w = &weights[c * lanes];
+			xc = &x[c * lanes];
+			for (g = 0; g < lanes; g++)
+			{
+				sums[g] += w[g] * xc[g];
+			}
+		}
+		weights += cols * lanes;
+		sums += lanes;
+	}
+}
+
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+__attribute__ ((target ("avx2,fma,f16c")))
+static void layer_group_avx2 (const fann_type *weights, const fann_type *x, S8 rows, S8 cols, S8 lanes, fann_type *sums)
+{
+	__m256 acc;
+	S8 r, c, g;
+
+	for (r = 0; r < rows; r++)
+	{
+		for (g = 0; g < lanes; g += KERNEL_LANES)
+		{
+			acc = _mm256_setzero_ps ();
+			for (c = 0; c < cols; c++)
+			{
+				acc = _mm256_fmadd_ps (_mm256_load_ps (&weights[c * lanes + g]), _mm256_load_ps (&x[c * lanes + g]), acc);
+			}
+			_mm256_store_ps (&sums[g], acc);
+		}
+		weights += cols * lanes;
+		sums += lanes;
+	}
+}
+#endif
+
+
+static void kernel_isa_detect (void)
+{
+	if (kernel_isa_init == TRUE)
+	{
+		return;
+	}
+
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma") && __builtin_cpu_supports ("f16c"))
+	{
+		kernel_isa_max = KERNEL_ISA_AVX2;
+	}
+	if (__builtin_cpu_supports ("avx512f"))
+	{
+		kernel_isa_max = KERNEL_ISA_AVX512;
+	}
+#endif
+
+	kernel_isa_init = TRUE;
+	Cells_kernel_set_isa (kernel_isa_max);
+}
+
+S2 Cells_kernel_set_isa (U1 isa)
+{
+	// use this instruction set for the kernels, not above the CPU one
+	kernel_isa_detect ();
+
+	if (isa > kernel_isa_max)
+	{
+		printf ("kernel_set_isa: error: instruction set %i not supported by the CPU!\n", isa);
+		return (1);
+	}
+
+	kernel_isa = isa;
+	kernel_layer = layer_scalar;
+	kernel_layer_f16 = layer_f16_scalar;
+	kernel_layer_bf16 = layer_bf16_scalar;
+	kernel_layer_sparse = layer_sparse_scalar;
+	kernel_layer_group = layer_group_scalar;
+#if defined(KERNEL_X86) && defined(FLOATFANN)
+	if (isa == KERNEL_ISA_AVX2)
+	{
+		kernel_layer = layer_avx2;
+		kernel_layer_f16 = layer_f16_avx2;
+		kernel_layer_bf16 = layer_bf16_avx2;
+		kernel_layer_sparse = layer_sparse_avx2;
+		kernel_layer_group = layer_group_avx2;
+	}
+	if (isa == KERNEL_ISA_AVX512)
+	{
+		kernel_layer = layer_avx512;
+		kernel_layer_f16 = layer_f16_avx512;
+		kernel_layer_bf16 = layer_bf16_avx512;
+		kernel_layer_sparse = layer_sparse_avx2;
+		kernel_layer_group = layer_group_avx2;
+	}
+#endif
+	return (0);
+}
+
+U1 Cells_kernel_isa (void)
+{
+	kernel_isa_detect ();
+	return (kernel_isa);
+}
+
+U1 Cells_kernel_isa_max (void)
+{
+	kernel_isa_detect ();
+	return (kernel_isa_max);
+}
+
+S2 Cells_kernel_set_sparse (F8 density)
+{
+	// layers with less weights not zero than density are sparse, for the kernels built after this
+	if (density < 0.0 || density > 1.0)
+	{
+		printf ("kernel_set_sparse: error: density must be in 0.0 ... 1.0!\n");
+		return (1);
+	}
+
+	kernel_sparse_density = density;
+	return (0);
+}
+
+
+// activation functions, as in fann_activation_switch ():
+
+static U1 activation_supported (U1 activation)
+{
+	switch (activation)
+	{
+		case FANN_LINEAR:
+		case FANN_THRESHOLD:
+		case FANN_THRESHOLD_SYMMETRIC:
+		case FANN_SIGMOID:
+		case FANN_SIGMOID_SYMMETRIC:
+		case FANN_GAUSSIAN:
+		case FANN_GAUSSIAN_SYMMETRIC:
+		case FANN_ELLIOT:
+		case FANN_ELLIOT_SYMMETRIC:
+		case FANN_LINEAR_PIECE:
+		case FANN_LINEAR_PIECE_SYMMETRIC:
+		case FANN_SIN_SYMMETRIC:
+		case FANN_COS_SYMMETRIC:
+		case FANN_SIN:
+		case FANN_COS:
+			return (TRUE);
+	}
+	return (FALSE);
+}
+
+static inline fann_type activation_run (U1 activation, fann_type steepness, fann_type sum)
+{
+	fann_type max_sum;
+
+	sum = steepness * sum;
+	max_sum = 150 / steepness;
+	if (sum > max_sum)
+	{
+		sum = max_sum;
+	}
+	else if (sum < -max_sum)
+	{
+		sum = -max_sum;
+	}
+
+	// float functions: the difference to the double ones of FANN is far below KERNEL_TOLERANCE
+	switch (activation)
+	{
+		case FANN_LINEAR:
+			return (sum);
+		case FANN_THRESHOLD:
+			return (sum < 0 ? 0 : 1);
+		case FANN_THRESHOLD_SYMMETRIC:
+			return (sum < 0 ? -1 : 1);
+		case FANN_SIGMOID:
+			return (1.0f / (1.0f + expf (-2.0f * sum)));
+		case FANN_SIGMOID_SYMMETRIC:
+			return (2.0f / (1.0f + expf (-2.0f * sum)) - 1.0f);
+		case FANN_GAUSSIAN:
+			return (expf (-sum * sum));
+		case FANN_GAUSSIAN_SYMMETRIC:
+			return ((expf (-sum * sum) * 2.0f) - 1.0f);
+		case FANN_ELLIOT:
+			return (((sum / 2) / (1 + fabsf (sum))) + 0.5f);
+		case FANN_ELLIOT_SYMMETRIC:
+			return (sum / (1 + fabsf (sum)));
+		case FANN_LINEAR_PIECE:
+			return (sum < 0 ? 0 : (sum > 1 ? 1 : sum));
+		case FANN_LINEAR_PIECE_SYMMETRIC:
+			return (sum < -1 ? -1 : (sum > 1 ? 1 : sum));
+		case FANN_SIN_SYMMETRIC:
+			return (sinf (sum));
+		case FANN_COS_SYMMETRIC:
+			return (cosf (sum));
+		case FANN_SIN:
+			return (sinf (sum) / 2.0f + 0.5f);
+		case FANN_COS:
+			return (cosf (sum) / 2.0f + 0.5f);
+	}
+	return (0);
+}
+
+
+static inline fann_type fast_tanh (const struct fast *fast, fann_type x)
+{
+	// table tanh, linear between the steps, NaN stays NaN as with fann_run
+	fann_type pos, frac;
+	S8 i;
+
+	if (!(x > -fast->range && x < fast->range))
+	{
+		if (x <= -fast->range)
+		{
+			return (-1);
+		}
+		if (x >= fast->range)
+		{
+			return (1);
+		}
+		return (x);
+	}
+
+	pos = (x + fast->range) * fast->scale;
+	i = (S8) pos;
+	frac = pos - i;
+	return (fast->values[i] + frac * (fast->values[i + 1] - fast->values[i]));
+}
+
+static inline fann_type activation_kernel (const struct kernel *kernel, U1 activation, fann_type steepness, fann_type sum)
+{
+	// with fast math: the sigmoid functions from the table
+	if (kernel->fast != NULL)
+	{
+		if (activation == FANN_SIGMOID_SYMMETRIC)
+		{
+			return (fast_tanh (kernel->fast, steepness * sum));
+		}
+		if (activation == FANN_SIGMOID)
+		{
+			return (0.5f * fast_tanh (kernel->fast, steepness * sum) + 0.5f);
+		}
+	}
+	return (activation_run (activation, steepness, sum));
+}
+
+
+// tiny nets:
+/* Kernels for 3 layer nets of fixed small shapes: all loops have constant
+ * bounds, so the compiler unrolls and vectorizes them. The weights of a
+ * layer are packed without padding by columns: the weights of input i to all
+ * neurons of the layer, then the bias weights. So the sums of all neurons are
+ * added up together, input by input.
+ * A tiny kernel is used if the shape is in kernel_tiny_shapes and all neurons
+ * of a layer have the same activation function and steepness.
+ */
+
+#define KERNEL_TINY(I, H, O) \
+static fann_type *tiny_##I##_##H##_##O (struct kernel *kernel, fann_type *input) \
+{ \
+	const fann_type *weights = kernel->tiny_weights; \
+	fann_type *output = kernel->output; \
+	fann_type hidden[H]; \
+	S8 i, j; \
+	\
+	for (j = 0; j < H; j++) \
+	{ \
+		hidden[j] = weights[I * H + j]; \
+	} \
+	for (i = 0; i < I; i++) \
+	{ \
+		for (j = 0; j < H; j++) \
+		{ \
+			hidden[j] += weights[i * H + j] * input[i]; \
+		} \
+	} \
+	for (j = 0; j < H; j++) \
+	{ \
+		hidden[j] = activation_kernel (kernel, kernel->tiny_activation[0], kernel->tiny_steepness[0], hidden[j]); \
+	} \
+	\
+	weights += (I + 1) * H; \
+	for (j = 0; j < O; j++) \
+	{ \
+		output[j] = weights[H * O + j]; \
+	} \
+	for (i = 0; i < H; i++) \
+	{ \
+		for (j = 0; j < O; j++) \
+		{ \
+			output[j] += weights[i * O + j] * hidden[i]; \
+		} \
+	} \
+	for (j = 0; j < O; j++) \
+	{ \
+		output[j] = activation_kernel (kernel, kernel->tiny_activation[1], kernel->tiny_steepness[1], output[j]); \
+	} \
+	return (output); \
+}
+
+KERNEL_TINY (1, 2, 1)
+KERNEL_TINY (2, 2, 1)
+KERNEL_TINY (2, 3, 1)
+KERNEL_TINY (2, 4, 1)
+KERNEL_TINY (3, 3, 1)
+KERNEL_TINY (3, 4, 2)
+KERNEL_TINY (4, 4, 1)
+KERNEL_TINY (4, 4, 2)
+KERNEL_TINY (4, 8, 1)
+KERNEL_TINY (4, 8, 2)
+KERNEL_TINY (4, 8, 4)
+KERNEL_TINY (8, 8, 1)
+KERNEL_TINY (8, 8, 2)
+KERNEL_TINY (8, 8, 4)
+KERNEL_TINY (8, 8, 8)
+KERNEL_TINY (8, 16, 1)
+KERNEL_TINY (8, 16, 4)
+KERNEL_TINY (8, 16, 8)
+KERNEL_TINY (16, 16, 1)
+KERNEL_TINY (16, 16, 4)
+KERNEL_TINY (16, 16, 8)
+KERNEL_TINY (16, 16, 16)
+
+struct kernel_tiny_shape
+{
+	S8 inputs;
+	S8 hidden;
+	S8 outputs;
+	kernel_tiny_func func;
+};
+
+static const struct kernel_tiny_shape kernel_tiny_shapes[] =
+{
+	{ 1, 2, 1, tiny_1_2_1 }, { 2, 2, 1, tiny_2_2_1 }, { 2, 3, 1, tiny_2_3_1 }, { 2, 4, 1, tiny_2_4_1 },
+	{ 3, 3, 1, tiny_3_3_1 }, { 3, 4, 2, tiny_3_4_2 }, { 4, 4, 1, tiny_4_4_1 }, { 4, 4, 2, tiny_4_4_2 },
+	{ 4, 8, 1, tiny_4_8_1 }, { 4, 8, 2, tiny_4_8_2 }, { 4, 8, 4, tiny_4_8_4 }, { 8, 8, 1, tiny_8_8_1 },
+	{ 8, 8, 2, tiny_8_8_2 }, { 8, 8, 4, tiny_8_8_4 }, { 8, 8, 8, tiny_8_8_8 }, { 8, 16, 1, tiny_8_16_1 },
+	{ 8, 16, 4, tiny_8_16_4 }, { 8, 16, 8, tiny_8_16_8 }, { 16, 16, 1, tiny_16_16_1 },
+	{ 16, 16, 4, tiny_16_16_4 }, { 16, 16, 8, tiny_16_16_8 }, { 16, 16, 16, tiny_16_16_16 }
+};
+
+static const struct kernel_tiny_shape *tiny_shape (struct fann *ann, unsigned int *sizes, S8 layers)
+{
+	// shape kernel of the ANN, NULL = none
+	S8 s, l, n;
+
+	if (layers != 3)
+	{
+		return (NULL);
+	}
+
+	for (l = 1; l < layers; l++)
+	{
+		for (n = 1; n < sizes[l]; n++)
+		{
+			if (fann_get_activation_function (ann, l, n) != fann_get_activation_function (ann, l, 0)
+				|| fann_get_activation_steepness (ann, l, n) != fann_get_activation_steepness (ann, l, 0))
+			{
+				return (NULL);
+			}
+		}
+	}
+
+	for (s = 0; s < (S8) (sizeof (kernel_tiny_shapes) / sizeof (kernel_tiny_shapes[0])); s++)
+	{
+		if (kernel_tiny_shapes[s].inputs == sizes[0] && kernel_tiny_shapes[s].hidden == sizes[1] && kernel_tiny_shapes[s].outputs == sizes[2])
+		{
+			return (&kernel_tiny_shapes[s]);
+		}
+	}
+	return (NULL);
+}
+
+static void tiny_pack (struct kernel *kernel)
+{
+	// copy the layer weights by columns, without the padding
+	struct kernel_layer *layer;
+	fann_type *weights;
+	S8 l, n, c;
+
+	weights = kernel->tiny_weights;
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		for (c = 0; c <= layer->inputs; c++)
+		{
+			for (n = 0; n < layer->outputs; n++)
+			{
+				weights[c * layer->outputs + n] = layer->weights[n * layer->cols + c];
+			}
+		}
+		weights += (layer->inputs + 1) * layer->outputs;
+		kernel->tiny_activation[l] = layer->activation[0];
+		kernel->tiny_steepness[l] = layer->steepness[0];
+	}
+}
+
+
+// kernel build and run:
+
+void kernel_free (struct kernel *kernel)
+{
+	S8 l;
+
+	if (kernel->layers && kernel->clone == FALSE)
+	{
+		// the arrays in a slab are freed with the slab
+		for (l = 0; l < kernel->layers_max && kernel->slab == NULL; l++)
+		{
+			if (kernel->layers[l].weights) cells_free (kernel->layers[l].weights);
+			if (kernel->layers[l].half) cells_free (kernel->layers[l].half);
+			if (kernel->layers[l].row_start) cells_free (kernel->layers[l].row_start);
+			if (kernel->layers[l].col_index) cells_free (kernel->layers[l].col_index);
+			if (kernel->layers[l].values) cells_free (kernel->layers[l].values);
+			if (kernel->layers[l].activation) cells_free (kernel->layers[l].activation);
+			if (kernel->layers[l].steepness) cells_free (kernel->layers[l].steepness);
+		}
+		cells_free (kernel->layers);
+	}
+	if (kernel->quant) quant_free (kernel->quant);
+	if (kernel->x) cells_free (kernel->x);
+	if (kernel->sums) cells_free (kernel->sums);
+	if (kernel->output) cells_free (kernel->output);
+	cells_free (kernel);
+}
+
+static S2 kernel_alloc (struct kernel *kernel, struct fann *ann, unsigned int *sizes)
+{
+	struct kernel_layer *layer;
+	S8 l, n;
+
+	kernel->layers = (struct kernel_layer *) cells_calloc (kernel->layers_max, sizeof (struct kernel_layer));
+	if (kernel->layers == NULL)
+	{
+		return (1);
+	}
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		layer->inputs = sizes[l];
+		layer->outputs = sizes[l + 1];
+		layer->cols = (layer->inputs + 1 + KERNEL_PAD - 1) / KERNEL_PAD * KERNEL_PAD;
+		if (layer->cols > kernel->cols_max) kernel->cols_max = layer->cols;
+		if (layer->outputs > kernel->cols_max) kernel->cols_max = layer->outputs;
+
+		layer->weights = (fann_type *) cells_aligned_alloc (layer->outputs * layer->cols * sizeof (fann_type));
+		layer->activation = (U1 *) cells_calloc (layer->outputs, sizeof (U1));
+		layer->steepness = (fann_type *) cells_calloc (layer->outputs, sizeof (fann_type));
+		if (layer->weights == NULL || layer->activation == NULL || layer->steepness == NULL)
+		{
+			return (1);
+		}
+
+		for (n = 0; n < layer->outputs; n++)
+		{
+			layer->activation[n] = fann_get_activation_function (ann, l + 1, n);
+			layer->steepness[n] = fann_get_activation_steepness (ann, l + 1, n);
+		}
+	}
+
+	kernel->x = (fann_type *) cells_aligned_alloc (kernel->cols_max * sizeof (fann_type));
+	kernel->sums = (fann_type *) cells_aligned_alloc (kernel->cols_max * sizeof (fann_type));
+	kernel->output = (fann_type *) cells_aligned_alloc (sizes[kernel->layers_max] * sizeof (fann_type));
+	if (kernel->x == NULL || kernel->sums == NULL || kernel->output == NULL)
+	{
+		return (1);
+	}
+	return (0);
+}
+
+static S2 sparse_pack (struct kernel *kernel)
+{
+	// layers with few weights not zero: compressed rows instead of the dense rows
+	struct kernel_layer *layer;
+	fann_type *row;
+	S8 l, n, c, k, count;
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		count = 0;
+		for (n = 0; n < layer->outputs * layer->cols; n++)
+		{
+			if (layer->weights[n] != 0) count++;
+		}
+
+		if (count >= kernel_sparse_density * layer->outputs * (layer->inputs + 1))
+		{
+			continue;
+		}
+
+		layer->row_start = (S4 *) cells_calloc (layer->outputs + 1, sizeof (S4));
+		layer->col_index = (S4 *) cells_calloc (count + 1, sizeof (S4));
+		layer->values = (fann_type *) cells_calloc (count + 1, sizeof (fann_type));
+		if (layer->row_start == NULL || layer->col_index == NULL || layer->values == NULL)
+		{
+			return (1);
+		}
+
+		k = 0;
+		for (n = 0; n < layer->outputs; n++)
+		{
+			layer->row_start[n] = k;
+			row = &layer->weights[n * layer->cols];
+			for (c = 0; c <= layer->inputs; c++)
+			{
+				if (row[c] != 0)
+				{
+					layer->col_index[k] = c;
+					layer->values[k] = row[c];
+					k++;
+				}
+			}
+		}
+		layer->row_start[layer->outputs] = k;
+
+		cells_free (layer->weights);
+		layer->weights = NULL;
+	}
+	return (0);
+}
+
+S2 kernel_create (struct fann *ann, struct kernel **kernel_ret)
+{
+	// kernel of a layered ANN, *kernel_ret = NULL: ANN not supported
+	struct kernel *kernel;
+	struct kernel_layer *layer;
+	struct fann_connection *connections;
+	const struct kernel_tiny_shape *shape;
+	unsigned int sizes[KERNEL_LAYERS_MAX];
+	unsigned int bias[KERNEL_LAYERS_MAX];
+	S8 start[KERNEL_LAYERS_MAX];
+	S8 layers, connections_max, dense = 0, tiny_size = 0;
+	S8 l, n, c, row, col;
+
+	*kernel_ret = NULL;
+	kernel_isa_detect ();
+
+	layers = fann_get_num_layers (ann);
+	if (fann_get_network_type (ann) != FANN_NETTYPE_LAYER || layers < 2 || layers > KERNEL_LAYERS_MAX)
+	{
+		return (0);
+	}
+
+	fann_get_layer_array (ann, sizes);
+	fann_get_bias_array (ann, bias);
+
+	// first global neuron number of every layer, with the bias neurons
+	start[0] = 0;
+	for (l = 1; l < layers; l++)
+	{
+		if (bias[l - 1] != 1)
+		{
+			return (0);
+		}
+		start[l] = start[l - 1] + sizes[l - 1] + bias[l - 1];
+		dense += (S8) sizes[l] * (sizes[l - 1] + 1);
+	}
+
+	// all connections, or some of them: a sparse net
+	connections_max = fann_get_total_connections (ann);
+	if (connections_max > dense)
+	{
+		return (0);
+	}
+
+	for (l = 1; l < layers; l++)
+	{
+		for (n = 0; n < sizes[l]; n++)
+		{
+			if (activation_supported (fann_get_activation_function (ann, l, n)) == FALSE)
+			{
+				return (0);
+			}
+		}
+	}
+
+	shape = tiny_shape (ann, sizes, layers);
+	if (shape != NULL)
+	{
+		tiny_size = dense * sizeof (fann_type);
+	}
+
+	connections = (struct fann_connection *) cells_calloc (connections_max + 1, sizeof (struct fann_connection));
+	kernel = (struct kernel *) cells_aligned_alloc (sizeof (struct kernel) + tiny_size);
+	if (connections == NULL || kernel == NULL)
+	{
+		printf ("kernel_create: out of memory, allocating kernel!\n");
+		if (connections) cells_free (connections);
+		if (kernel) cells_free (kernel);
+		return (1);
+	}
+
+	kernel->layers_max = layers - 1;
+	kernel->tiny_size = tiny_size;
+	if (kernel_alloc (kernel, ann, sizes) != 0)
+	{
+		printf ("kernel_create: out of memory, allocating kernel!\n");
+		cells_free (connections);
+		kernel_free (kernel);
+		return (1);
+	}
+
+	// pack the weights: row = neuron of the layer, column = neuron of the layer before
+	fann_get_connection_array (ann, connections);
+	for (c = 0; c < connections_max; c++)
+	{
+		for (l = 1; l < layers; l++)
+		{
+			if (connections[c].to_neuron >= start[l] && connections[c].to_neuron < start[l] + sizes[l])
+			{
+				break;
+			}
+		}
+
+		col = -1;
+		if (l < layers)
+		{
+			col = connections[c].from_neuron - start[l - 1];
+		}
+
+		if (col < 0 || col > sizes[l - 1])
+		{
+			// not a connection from the layer before: no kernel
+			cells_free (connections);
+			kernel_free (kernel);
+			return (0);
+		}
+
+		layer = &kernel->layers[l - 1];
+		row = connections[c].to_neuron - start[l];
+		layer->weights[row * layer->cols + col] = connections[c].weight;
+	}
+
+	cells_free (connections);
+
+	if (shape != NULL)
+	{
+		// the missing connections are zero weights of the tiny kernel
+		tiny_pack (kernel);
+		kernel->tiny = shape->func;
+	}
+	else if (sparse_pack (kernel) != 0)
+	{
+		printf ("kernel_create: out of memory, allocating sparse layers!\n");
+		kernel_free (kernel);
+		return (1);
+	}
+
+	*kernel_ret = kernel;
+	return (0);
+}
+
+fann_type *kernel_run (struct kernel *kernel, struct fann *ann, fann_type *input)
+{
+	// run the ANN with the kernel, or with fann_run if it has none
+	fann_type *output;
+
+	if (kernel == NULL)
+	{
+		return (fann_run (ann, input));
+	}
+
+	if (kernel->quant != NULL)
+	{
+		// NULL while the quantization is calibrated: run the float layers
+		output = quant_run (kernel->quant, kernel, input);
+		if (output != NULL)
+		{
+			return (output);
+		}
+	}
+	return (kernel_run_float (kernel, input));
+}
+
+fann_type *kernel_run_float (struct kernel *kernel, fann_type *input)
+{
+	// run the float layers of the kernel
+	struct kernel_layer *layer;
+	fann_type *x;
+	fann_type *sums;
+	S8 l, n;
+
+	if (kernel->tiny != NULL)
+	{
+		return (kernel->tiny (kernel, input));
+	}
+
+	x = kernel->x;
+	sums = kernel->sums;
+
+	layer = &kernel->layers[0];
+	memcpy (x, input, layer->inputs * sizeof (fann_type));
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+
+		// bias and padding
+		x[layer->inputs] = 1;
+		for (n = layer->inputs + 1; n < layer->cols; n++)
+		{
+			x[n] = 0;
+		}
+
+		if (layer->values != NULL)
+		{
+			kernel_layer_sparse (layer->row_start, layer->col_index, layer->values, x, layer->outputs, sums);
+		}
+		else if (kernel->weights == WEIGHTS_F32)
+		{
+			kernel_layer (layer->weights, x, layer->outputs, layer->cols, sums);
+		}
+		else if (kernel->weights == WEIGHTS_F16)
+		{
+			kernel_layer_f16 (layer->half, x, layer->outputs, layer->cols, sums);
+		}
+		else
+		{
+			kernel_layer_bf16 (layer->half, x, layer->outputs, layer->cols, sums);
+		}
+
+		for (n = 0; n < layer->outputs; n++)
+		{
+			x[n] = activation_kernel (kernel, layer->activation[n], layer->steepness[n], sums[n]);
+		}
+	}
+
+	memcpy (kernel->output, x, layer->outputs * sizeof (fann_type));
+	return (kernel->output);
+}
+
+S2 kernel_clone (struct kernel *kernel, struct kernel **clone_ret)
+{
+	// kernel with the same layers and own run buffers, for a run context
+	struct kernel *clone;
+	S8 width;
+
+	*clone_ret = NULL;
+	clone = (struct kernel *) cells_aligned_alloc (sizeof (struct kernel) + kernel->tiny_size);
+	if (clone == NULL)
+	{
+		return (1);
+	}
+
+	// the tiny weights are copied with the structure
+	memcpy (clone, kernel, sizeof (struct kernel) + kernel->tiny_size);
+	clone->clone = TRUE;
+	clone->x = NULL;
+	clone->sums = NULL;
+	clone->output = NULL;
+	clone->quant = NULL;
+
+	width = clone->cols_max * (clone->lanes > 0 ? clone->lanes : 1);
+	clone->x = (fann_type *) cells_aligned_alloc (width * sizeof (fann_type));
+	clone->sums = (fann_type *) cells_aligned_alloc (width * sizeof (fann_type));
+	if (clone->x == NULL || clone->sums == NULL)
+	{
+		kernel_free (clone);
+		return (1);
+	}
+
+	if (kernel->output != NULL)
+	{
+		clone->output = (fann_type *) cells_aligned_alloc (clone->layers[clone->layers_max - 1].outputs * sizeof (fann_type));
+		if (clone->output == NULL)
+		{
+			kernel_free (clone);
+			return (1);
+		}
+	}
+
+	if (kernel->quant != NULL && quant_clone (kernel->quant, &clone->quant) != 0)
+	{
+		kernel_free (clone);
+		return (1);
+	}
+
+	*clone_ret = clone;
+	return (0);
+}
+
+
+// layers, for the int8 kernel of quant.c:
+
+S8 kernel_layers (struct kernel *kernel)
+{
+	return (kernel->layers_max);
+}
+
+void kernel_layer_get (struct kernel *kernel, S8 layer, S8 *inputs, S8 *outputs, S8 *cols, fann_type **weights)
+{
+	// weights: rows of cols values, the bias weight after the inputs
+	*inputs = kernel->layers[layer].inputs;
+	*outputs = kernel->layers[layer].outputs;
+	*cols = kernel->layers[layer].cols;
+	*weights = kernel->layers[layer].weights;
+}
+
+void kernel_activate (struct kernel *kernel, S8 layer, fann_type *sums, fann_type *x)
+{
+	// activation functions of a layer: x = f (sums)
+	struct kernel_layer *kl;
+	S8 n;
+
+	kl = &kernel->layers[layer];
+	for (n = 0; n < kl->outputs; n++)
+	{
+		x[n] = activation_kernel (kernel, kl->activation[n], kl->steepness[n], sums[n]);
+	}
+}
+
+void kernel_set_quant (struct kernel *kernel, struct quant *quant)
+{
+	// int8 layers of the kernel, NULL = float, the kernel frees them
+	if (kernel->quant != NULL && kernel->quant != quant)
+	{
+		quant_free (kernel->quant);
+	}
+	kernel->quant = quant;
+}
+
+struct quant *kernel_get_quant (struct kernel *kernel)
+{
+	return (kernel->quant);
+}
+
+U1 kernel_sparse (struct kernel *kernel)
+{
+	// TRUE: the kernel has sparse layers
+	S8 l;
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		if (kernel->layers[l].values != NULL)
+		{
+			return (TRUE);
+		}
+	}
+	return (FALSE);
+}
+
+
+// fused chains and groups, for fuse.c:
+
+U1 kernel_fusable (struct kernel *kernel)
+{
+	// TRUE: dense float layers, which kernel_fuse can copy
+	if (kernel->weights != WEIGHTS_F32 || kernel->quant != NULL || kernel_sparse (kernel) == TRUE)
+	{
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+S2 kernel_fuse (struct kernel **kernels, S8 kernels_max, S8 **maps, struct kernel **fused_ret)
+{
+	// one kernel with the layers of all kernels, *fused_ret = NULL: too many layers
+	// maps [k]: for every input of kernels [k] the output of kernels [k - 1] it gets
+	struct kernel *fused;
+	struct kernel_layer *layer;
+	struct kernel_layer *from;
+	S8 layers = 0;
+	S8 k, l, f, r, c;
+
+	*fused_ret = NULL;
+	for (k = 0; k < kernels_max; k++)
+	{
+		layers += kernels[k]->layers_max;
+	}
+	if (layers >= KERNEL_LAYERS_MAX)
+	{
+		return (0);
+	}
+
+	fused = (struct kernel *) cells_aligned_alloc (sizeof (struct kernel));
+	if (fused == NULL)
+	{
+		return (1);
+	}
+
+	fused->layers_max = layers;
+	fused->weights = WEIGHTS_F32;
+	fused->fast = kernels[0]->fast;
+	fused->layers = (struct kernel_layer *) cells_calloc (layers, sizeof (struct kernel_layer));
+	if (fused->layers == NULL)
+	{
+		kernel_free (fused);
+		return (1);
+	}
+
+	f = 0;
+	for (k = 0; k < kernels_max; k++)
+	{
+		for (l = 0; l < kernels[k]->layers_max; l++, f++)
+		{
+			from = &kernels[k]->layers[l];
+			layer = &fused->layers[f];
+			layer->inputs = from->inputs;
+			layer->outputs = from->outputs;
+			layer->cols = from->cols;
+			if (k > 0 && l == 0)
+			{
+				// the first layer reads the outputs of the kernel before
+				layer->inputs = kernels[k - 1]->layers[kernels[k - 1]->layers_max - 1].outputs;
+				layer->cols = (layer->inputs + 1 + KERNEL_PAD - 1) / KERNEL_PAD * KERNEL_PAD;
+			}
+			if (layer->cols > fused->cols_max) fused->cols_max = layer->cols;
+			if (layer->outputs > fused->cols_max) fused->cols_max = layer->outputs;
+
+			layer->weights = (fann_type *) cells_aligned_alloc (layer->outputs * layer->cols * sizeof (fann_type));
+			layer->activation = (U1 *) cells_calloc (layer->outputs, sizeof (U1));
+			layer->steepness = (fann_type *) cells_calloc (layer->outputs, sizeof (fann_type));
+			if (layer->weights == NULL || layer->activation == NULL || layer->steepness == NULL)
+			{
+				kernel_free (fused);
+				return (1);
+			}
+
+			memcpy (layer->activation, from->activation, layer->outputs * sizeof (U1));
+			memcpy (layer->steepness, from->steepness, layer->outputs * sizeof (fann_type));
+			if (k == 0 || l > 0)
+			{
+				memcpy (layer->weights, from->weights, layer->outputs * layer->cols * sizeof (fann_type));
+				continue;
+			}
+
+			// links: the weight of an input goes to the output linked to it, the bias stays last
+			for (r = 0; r < layer->outputs; r++)
+			{
+				for (c = 0; c < from->inputs; c++)
+				{
+					layer->weights[r * layer->cols + maps[k][c]] += from->weights[r * from->cols + c];
+				}
+				layer->weights[r * layer->cols + layer->inputs] = from->weights[r * from->cols + from->inputs];
+			}
+		}
+	}
+
+	fused->x = (fann_type *) cells_aligned_alloc (fused->cols_max * sizeof (fann_type));
+	fused->sums = (fann_type *) cells_aligned_alloc (fused->cols_max * sizeof (fann_type));
+	fused->output = (fann_type *) cells_aligned_alloc (fused->layers[layers - 1].outputs * sizeof (fann_type));
+	if (fused->x == NULL || fused->sums == NULL || fused->output == NULL)
+	{
+		kernel_free (fused);
+		return (1);
+	}
+
+	*fused_ret = fused;
+	return (0);
+}
+
+U1 kernel_same (struct kernel *a, struct kernel *b)
+{
+	// TRUE: same layers and activations, only the weights can be different
+	struct kernel_layer *la;
+	struct kernel_layer *lb;
+	S8 l;
+
+	if (a->layers_max != b->layers_max)
+	{
+		return (FALSE);
+	}
+
+	for (l = 0; l < a->layers_max; l++)
+	{
+		la = &a->layers[l];
+		lb = &b->layers[l];
+		if (la->inputs != lb->inputs || la->outputs != lb->outputs
+			|| memcmp (la->activation, lb->activation, la->outputs * sizeof (U1)) != 0
+			|| memcmp (la->steepness, lb->steepness, la->outputs * sizeof (fann_type)) != 0)
+		{
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+S2 kernel_group (struct kernel **kernels, S8 kernels_max, struct kernel **group_ret)
+{
+	// group kernel of kernel_same kernels: weights [row][col][lane], lane = kernel
+	struct kernel *group;
+	struct kernel_layer *layer;
+	struct kernel_layer *from;
+	S8 l, k, r, c;
+
+	*group_ret = NULL;
+	group = (struct kernel *) cells_aligned_alloc (sizeof (struct kernel));
+	if (group == NULL)
+	{
+		return (1);
+	}
+
+	group->layers_max = kernels[0]->layers_max;
+	group->weights = WEIGHTS_F32;
+	group->fast = kernels[0]->fast;
+	group->lanes = (kernels_max + KERNEL_LANES - 1) / KERNEL_LANES * KERNEL_LANES;
+	group->layers = (struct kernel_layer *) cells_calloc (group->layers_max, sizeof (struct kernel_layer));
+	if (group->layers == NULL)
+	{
+		kernel_free (group);
+		return (1);
+	}
+
+	for (l = 0; l < group->layers_max; l++)
+	{
+		from = &kernels[0]->layers[l];
+		layer = &group->layers[l];
+		layer->inputs = from->inputs;
+		layer->outputs = from->outputs;
+		layer->cols = from->inputs + 1;
+		if (layer->cols > group->cols_max) group->cols_max = layer->cols;
+		if (layer->outputs > group->cols_max) group->cols_max = layer->outputs;
+
+		layer->weights = (fann_type *) cells_aligned_alloc (layer->outputs * layer->cols * group->lanes * sizeof (fann_type));
+		layer->activation = (U1 *) cells_calloc (layer->outputs, sizeof (U1));
+		layer->steepness = (fann_type *) cells_calloc (layer->outputs, sizeof (fann_type));
+		if (layer->weights == NULL || layer->activation == NULL || layer->steepness == NULL)
+		{
+			kernel_free (group);
+			return (1);
+		}
+
+		memcpy (layer->activation, from->activation, layer->outputs * sizeof (U1));
+		memcpy (layer->steepness, from->steepness, layer->outputs * sizeof (fann_type));
+		for (k = 0; k < kernels_max; k++)
+		{
+			from = &kernels[k]->layers[l];
+			for (r = 0; r < layer->outputs; r++)
+			{
+				for (c = 0; c < layer->cols; c++)
+				{
+					layer->weights[(r * layer->cols + c) * group->lanes + k] = from->weights[r * from->cols + c];
+				}
+			}
+		}
+	}
+
+	group->x = (fann_type *) cells_aligned_alloc (group->cols_max * group->lanes * sizeof (fann_type));
+	group->sums = (fann_type *) cells_aligned_alloc (group->cols_max * group->lanes * sizeof (fann_type));
+	if (group->x == NULL || group->sums == NULL)
+	{
+		kernel_free (group);
+		return (1);
+	}
+
+	*group_ret = group;
+	return (0);
+}
+
+fann_type *kernel_group_run (struct kernel *group, fann_type **inputs, S8 nodes)
+{
+	// run nodes inputs, returns the outputs [output][lane], lane = node
+	struct kernel_layer *layer;
+	fann_type *x;
+	fann_type *sums;
+	S8 lanes, l, n, g;
+
+	x = group->x;
+	sums = group->sums;
+	lanes = group->lanes;
+
+	layer = &group->layers[0];
+	for (g = 0; g < nodes; g++)
+	{
+		for (n = 0; n < layer->inputs; n++)
+		{
+			x[n * lanes + g] = inputs[g][n];
+		}
+	}
+
+	for (l = 0; l < group->layers_max; l++)
+	{
+		layer = &group->layers[l];
+		for (g = 0; g < lanes; g++)
+		{
+			x[layer->inputs * lanes + g] = 1;
+		}
+
+		kernel_layer_group (layer->weights, x, layer->outputs, layer->cols, lanes, sums);
+
+		for (n = 0; n < layer->outputs; n++)
+		{
+			for (g = 0; g < lanes; g++)
+			{
+				x[n * lanes + g] = activation_kernel (group, layer->activation[n], layer->steepness[n], sums[n * lanes + g]);
+			}
+		}
+	}
+	return (x);
+}
+
+S8 kernel_group_lanes (struct kernel *group)
+{
+	return (group->lanes);
+}
+
+
+// weight slab, see slab.c:
+
+#define KERNEL_SLAB_SIZE(bytes) (((bytes) + CELLS_ALIGN - 1) & ~((S8) CELLS_ALIGN - 1))
+
+S8 kernel_slab_bytes (struct kernel *kernel)
+{
+	// bytes of the layer arrays in a slab, every array cache line aligned
+	struct kernel_layer *layer;
+	S8 l, values, bytes = 0;
+
+	if (kernel->tiny != NULL)
+	{
+		// the weights of tiny kernels are in the kernel structure
+		return (0);
+	}
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		if (layer->weights) bytes += KERNEL_SLAB_SIZE (layer->outputs * layer->cols * (S8) sizeof (fann_type) * (kernel->lanes > 0 ? kernel->lanes : 1));
+		if (layer->half) bytes += KERNEL_SLAB_SIZE (layer->outputs * layer->cols * (S8) sizeof (U2));
+		if (layer->values)
+		{
+			values = layer->row_start[layer->outputs] + 1;
+			bytes += KERNEL_SLAB_SIZE ((layer->outputs + 1) * (S8) sizeof (S4)) + KERNEL_SLAB_SIZE (values * (S8) sizeof (S4))
+				+ KERNEL_SLAB_SIZE (values * (S8) sizeof (fann_type));
+		}
+		bytes += KERNEL_SLAB_SIZE (layer->outputs * (S8) sizeof (U1)) + KERNEL_SLAB_SIZE (layer->outputs * (S8) sizeof (fann_type));
+	}
+	return (bytes);
+}
+
+static void *kernel_slab_move (struct kernel *kernel, U1 **to, void *ptr, S8 size)
+{
+	// copy an array to the next cache line of the slab block, a heap array is freed
+	void *array;
+
+	array = *to;
+	memcpy (array, ptr, size);
+	*to += KERNEL_SLAB_SIZE (size);
+	if (kernel->slab == NULL)
+	{
+		cells_free (ptr);
+	}
+	return (array);
+}
+
+S2 kernel_slab_pack (struct kernel *kernel, struct slab *slab)
+{
+	// move the layer arrays into the slab, the kernel is not changed if the slab is full
+	struct kernel_layer *layer;
+	U1 *to;
+	S8 l, values, bytes;
+
+	bytes = kernel_slab_bytes (kernel);
+	if (bytes == 0)
+	{
+		return (0);
+	}
+
+	to = (U1 *) slab_alloc (slab, bytes);
+	if (to == NULL)
+	{
+		return (1);
+	}
+
+	kernel->slab_start = to;
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		if (layer->weights) layer->weights = kernel_slab_move (kernel, &to, layer->weights, layer->outputs * layer->cols * sizeof (fann_type) * (kernel->lanes > 0 ? kernel->lanes : 1));
+		if (layer->half) layer->half = kernel_slab_move (kernel, &to, layer->half, layer->outputs * layer->cols * sizeof (U2));
+		if (layer->values)
+		{
+			values = layer->row_start[layer->outputs] + 1;
+			layer->col_index = kernel_slab_move (kernel, &to, layer->col_index, values * sizeof (S4));
+			layer->values = kernel_slab_move (kernel, &to, layer->values, values * sizeof (fann_type));
+			layer->row_start = kernel_slab_move (kernel, &to, layer->row_start, (layer->outputs + 1) * sizeof (S4));
+		}
+		layer->activation = kernel_slab_move (kernel, &to, layer->activation, layer->outputs * sizeof (U1));
+		layer->steepness = kernel_slab_move (kernel, &to, layer->steepness, layer->outputs * sizeof (fann_type));
+	}
+	kernel->slab = slab;
+	kernel->slab_bytes = bytes;
+	return (0);
+}
+
+void kernel_prefetch (struct kernel *kernel)
+{
+	// prefetch the start of the slab arrays of a kernel which runs next
+	S8 i, bytes;
+
+	if (kernel == NULL || kernel->slab == NULL)
+	{
+		return;
+	}
+
+	bytes = kernel->slab_bytes < KERNEL_PREFETCH ? kernel->slab_bytes : KERNEL_PREFETCH;
+	for (i = 0; i < bytes; i += CELLS_ALIGN)
+	{
+		__builtin_prefetch (kernel->slab_start + i, 0, 3);
+	}
+}
+
+
+// verify:
+
+S2 kernel_compare (struct kernel *kernel, struct fann *ann, S8 samples, U1 grid, F8 *max_error)
+{
+	// run random inputs in -1 ... 1 through the kernel and fann_run, grid: inputs in steps of KERNEL_GRID
+	fann_type *input;
+	fann_type *output;
+	fann_type *output_fann;
+	F8 error, scale;
+	S8 inputs, outputs, s, i;
+
+	inputs = kernel->layers[0].inputs;
+	outputs = kernel->layers[kernel->layers_max - 1].outputs;
+
+	input = (fann_type *) cells_calloc (inputs + 1, sizeof (fann_type));
+	if (input == NULL)
+	{
+		printf ("kernel_verify: out of memory!\n");
+		return (1);
+	}
+
+	*max_error = 0.0;
+	for (s = 0; s < samples; s++)
+	{
+		for (i = 0; i < inputs; i++)
+		{
+			if (grid == TRUE)
+			{
+				input[i] = (fann_type) ((rand () % (2 * KERNEL_GRID + 1)) - KERNEL_GRID) / KERNEL_GRID;
+				continue;
+			}
+			input[i] = (fann_type) (2.0 * rand () / RAND_MAX - 1.0);
+		}
+
+		output = kernel_run (kernel, ann, input);
+		output_fann = fann_run (ann, input);
+
+		for (i = 0; i < outputs; i++)
+		{
+			scale = fabs (output_fann[i]) > 1.0 ? fabs (output_fann[i]) : 1.0;
+			error = fabs ((F8) output[i] - (F8) output_fann[i]) / scale;
+			if (error > *max_error)
+			{
+				*max_error = error;
+			}
+		}
+	}
+
+	cells_free (input);
+	return (0);
+}
+
+S2 Cells_kernel_verify (struct cell *cells, S8 cell, S8 node, S8 samples, F8 *max_error)
+{
+	// max_error: biggest difference to fann_run, relative above 1.0
+	struct neuron *neuron;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("kernel_verify: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("kernel_verify: error: node out of range!\n");
+		return (1);
+	}
+
+	neuron = &cells[cell].neurons[node];
+	if (neuron->kernel == NULL)
+	{
+		printf ("kernel_verify: error: node has no kernel: cell: %lli, node: %lli!\n", cell, node);
+		return (1);
+	}
+
+	if (kernel_compare (neuron->kernel, neuron->ann, samples, FALSE, max_error) != 0)
+	{
+		return (1);
+	}
+
+	// fast math and 16 bit weights have bigger errors: only the max error is returned
+	if (neuron->kernel->fast == NULL && neuron->kernel->weights == WEIGHTS_F32 && *max_error > KERNEL_TOLERANCE)
+	{
+		printf ("kernel_verify: error: max error %e above tolerance: cell: %lli, node: %lli!\n", *max_error, cell, node);
+		return (1);
+	}
+	return (0);
+}
+
+static S2 kernel_selftest_grid (struct fann *ann)
+{
+	// weights in steps of 1 / KERNEL_GRID: with grid inputs all sums are exact in float, in any order
+	struct fann_connection *connections;
+	S8 connections_max, c;
+
+	connections_max = fann_get_total_connections (ann);
+	connections = (struct fann_connection *) cells_calloc (connections_max + 1, sizeof (struct fann_connection));
+	if (connections == NULL)
+	{
+		printf ("kernel_selftest: out of memory!\n");
+		return (1);
+	}
+
+	fann_get_connection_array (ann, connections);
+	for (c = 0; c < connections_max; c++)
+	{
+		connections[c].weight = (fann_type) (rintf (connections[c].weight * KERNEL_GRID) / KERNEL_GRID);
+	}
+	fann_set_weight_array (ann, connections, connections_max);
+
+	cells_free (connections);
+	return (0);
+}
+
+S2 Cells_kernel_selftest (S8 samples, F8 *max_error)
+{
+	// nets with all supported activation functions, on all instruction sets
+	static const U1 activations[] =
+	{
+		FANN_LINEAR, FANN_THRESHOLD, FANN_THRESHOLD_SYMMETRIC, FANN_SIGMOID, FANN_SIGMOID_SYMMETRIC,
+		FANN_GAUSSIAN, FANN_GAUSSIAN_SYMMETRIC, FANN_ELLIOT, FANN_ELLIOT_SYMMETRIC, FANN_LINEAR_PIECE,
+		FANN_LINEAR_PIECE_SYMMETRIC, FANN_SIN_SYMMETRIC, FANN_COS_SYMMETRIC, FANN_SIN, FANN_COS
+	};
+	struct fann *ann;
+	struct kernel *kernel;
+	F8 error;
+	U1 isa, isa_old, grid;
+	S8 a;
+	S2 ret = 0;
+
+	kernel_isa_detect ();
+	isa_old = kernel_isa;
+	*max_error = 0.0;
+
+	for (a = 0; a < (S8) sizeof (activations); a++)
+	{
+		// a tiny shape, a general net and a sparse net
+		if (a % 3 == 0)
+		{
+			ann = fann_create_standard (3, 2, 3, 1);
+		}
+		else if (a % 3 == 1)
+		{
+			ann = fann_create_standard (4, 7, 19, 9, 3);
+		}
+		else
+		{
+			ann = fann_create_sparse (0.2, 4, 40, 64, 32, 3);
+		}
+		if (ann == NULL)
+		{
+			printf ("kernel_selftest: error: can't create ANN!\n");
+			return (1);
+		}
+
+		fann_set_activation_function_hidden (ann, activations[a]);
+		fann_set_activation_function_output (ann, activations[a]);
+		fann_set_activation_steepness_hidden (ann, 0.5);
+		fann_set_activation_steepness_output (ann, 1.0);
+		fann_randomize_weights (ann, -1.0, 1.0);
+
+		// a threshold flips on the smallest difference of a sum near 0: these nets run exact sums
+		grid = activations[a] == FANN_THRESHOLD || activations[a] == FANN_THRESHOLD_SYMMETRIC;
+		if (grid == TRUE && kernel_selftest_grid (ann) != 0)
+		{
+			fann_destroy (ann);
+			return (1);
+		}
+
+		if (kernel_create (ann, &kernel) != 0 || kernel == NULL)
+		{
+			printf ("kernel_selftest: error: no kernel for activation function %i!\n", activations[a]);
+			fann_destroy (ann);
+			return (1);
+		}
+
+		for (isa = KERNEL_ISA_SCALAR; isa <= kernel_isa_max; isa++)
+		{
+			Cells_kernel_set_isa (isa);
+			if (kernel_compare (kernel, ann, samples, grid, &error) != 0)
+			{
+				ret = 1;
+				break;
+			}
+
+			if (error > KERNEL_TOLERANCE)
+			{
+				printf ("kernel_selftest: error: activation function %i, instruction set %i: max error %e!\n", activations[a], isa, error);
+				ret = 1;
+			}
+			if (error > *max_error)
+			{
+				*max_error = error;
+			}
+		}
+
+		kernel_free (kernel);
+		fann_destroy (ann);
+	}
+
+	Cells_kernel_set_isa (isa_old);
+	return (ret);
+}
+
+S2 kernel_node (struct cell *cells, S8 cell, S8 node)
+{
+	// build or free the kernel of a node, as set for the cell
+	struct neuron *neuron;
+
+	neuron = &cells[cell].neurons[node];
+	if (neuron->kernel != NULL)
+	{
+		kernel_free (neuron->kernel);
+		neuron->kernel = NULL;
+	}
+
+	// the cached outputs are from the old kernel
+	memo_flush (neuron->memo);
+
+	if (cells[cell].kernel == KERNEL_NATIVE && neuron->fann_state == ANNOPEN)
+	{
+		if (kernel_create (neuron->ann, &neuron->kernel) != 0)
+		{
+			return (1);
+		}
+		if (neuron->kernel != NULL)
+		{
+			kernel_set_fast (neuron->kernel, cells[cell].fast);
+			if (kernel_set_weights (neuron->kernel, cells[cell].cold[node].weights) != 0)
+			{
+				return (1);
+			}
+		}
+	}
+	return (0);
+}
+
+S2 kernel_set_weights (struct kernel *kernel, U1 weights)
+{
+	// store the weights as WEIGHTS_F16 or WEIGHTS_BF16, the float weights are freed
+	struct kernel_layer *layer;
+	S8 l, i, size;
+
+	if (weights == WEIGHTS_F32 || kernel->weights != WEIGHTS_F32)
+	{
+		return (0);
+	}
+
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		layer = &kernel->layers[l];
+		if (layer->values != NULL)
+		{
+			// sparse layers keep their float weights
+			continue;
+		}
+
+		size = layer->outputs * layer->cols;
+		layer->half = (U2 *) cells_aligned_alloc (size * sizeof (U2));
+		if (layer->half == NULL)
+		{
+			printf ("kernel_set_weights: out of memory, allocating weights!\n");
+			return (1);
+		}
+
+		for (i = 0; i < size; i++)
+		{
+			layer->half[i] = weights == WEIGHTS_F16 ? float_to_f16 (layer->weights[i]) : float_to_bf16 (layer->weights[i]);
+		}
+		if (kernel->slab == NULL) cells_free (layer->weights);
+		layer->weights = NULL;
+	}
+
+	// the tiny kernels only have float weights
+	kernel->tiny = NULL;
+	kernel->weights = weights;
+	return (0);
+}
+
+U1 kernel_weights (struct kernel *kernel)
+{
+	return (kernel->weights);
+}
+
+S8 kernel_weights_bytes (struct kernel *kernel, S8 *float_bytes)
+{
+	// bytes of the layer weights, float_bytes: as float
+	S8 l, size, bytes = 0;
+
+	*float_bytes = 0;
+	for (l = 0; l < kernel->layers_max; l++)
+	{
+		if (kernel->layers[l].values != NULL)
+		{
+			size = kernel->layers[l].row_start[kernel->layers[l].outputs];
+			size = size * (sizeof (fann_type) + sizeof (S4)) + (kernel->layers[l].outputs + 1) * sizeof (S4);
+			bytes += size;
+			*float_bytes += size;
+			continue;
+		}
+
+		size = kernel->layers[l].outputs * kernel->layers[l].cols;
+		bytes += size * (kernel->weights == WEIGHTS_F32 ? sizeof (fann_type) : sizeof (U2));
+		*float_bytes += size * sizeof (fann_type);
+	}
+	return (bytes);
+}
+
+S2 Cells_set_node_weights (struct cell *cells, S8 cell, S8 node, U1 weights)
+{
+	// weights of the native kernel of a node: WEIGHTS_F32, WEIGHTS_F16 or WEIGHTS_BF16
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("set_node_weights: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("set_node_weights: error: node out of range!\n");
+		return (1);
+	}
+
+	if (weights != WEIGHTS_F32 && weights != WEIGHTS_F16 && weights != WEIGHTS_BF16)
+	{
+		printf ("set_node_weights: error: unknown weights: %i!\n", weights);
+		return (1);
+	}
+
+	cells[cell].cold[node].weights = weights;
+	if (kernel_node (cells, cell, node) != 0)
+	{
+		printf ("set_node_weights: error: can't build kernel: cell: %lli, node: %lli!\n", cell, node);
+		return (1);
+	}
+	cells[cell].topology++;
+	return (0);
+}
+
+S2 Cells_weights_bytes (struct cell *cells, S8 start_cell, S8 end_cell, S8 *bytes, S8 *saved)
+{
+	// weight bytes of all native kernels, saved: bytes less than with float weights
+	struct kernel *kernel;
+	S8 i, n, float_bytes;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("weights_bytes: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	*bytes = 0;
+	*saved = 0;
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			kernel = cells[i].neurons[n].kernel;
+			if (kernel != NULL)
+			{
+				*bytes += kernel_weights_bytes (kernel, &float_bytes);
+				*saved += float_bytes;
+			}
+		}
+	}
+	*saved -= *bytes;
+	return (0);
+}
+
+void kernel_set_fast (struct kernel *kernel, struct fast *fast)
+{
+	// fast math table of the activations, NULL = exact
+	kernel->fast = fast;
+}
+
+S2 Cells_set_kernel (struct cell *cells, S8 start_cell, S8 end_cell, U1 kernel)
+{
+	// KERNEL_FANN: run the ANNs with fann_run, KERNEL_NATIVE: with the native kernel if possible
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("set_kernel: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (kernel != KERNEL_FANN && kernel != KERNEL_NATIVE)
+	{
+		printf ("set_kernel: error: unknown kernel: %i!\n", kernel);
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		cells[i].kernel = kernel;
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (kernel_node (cells, i, n) != 0)
+			{
+				printf ("set_kernel: error: can't build kernel: cell: %lli, node: %lli!\n", i, n);
+				return (1);
+			}
+		}
+		cells[i].topology++;
+	}
+	return (0);
+}
@@ -1,8 +1,17 @@
 #!/bin/sh
 
-clang -Wall -fPIC -g -c cells.c file.c string.c -O3 -fomit-frame-pointer -g
-clang -shared -Wl,-soname,libcells.so.1 -o libcells.so.1.0 cells.o file.o string.o
+clang -Wall -fPIC -g -c cells.c file.c string.c plan.c pool.c batch.c alloc.c names.c demand.c memo.c kernel.c fast.c quant.c fuse.c slab.c bind.c context.c -O3 -fomit-frame-pointer -g
+clang -shared -Wl,-soname,libcells.so.1 -o libcells.so.1.0 cells.o file.o string.o plan.o pool.o batch.o alloc.o names.o demand.o memo.o kernel.o fast.o quant.o fuse.o slab.o bind.o context.o -lm -lpthread
 cp libcells.so.1.0 libcells.so
+cp libcells.so.1.0 libcells.so.1
+
+# test the new library before it is installed
+clang cells-test.c -o cells-test -Wall -g -L. -lcells -lfann -lm -lpthread
+if ! LD_LIBRARY_PATH=. ./cells-test ../fann
+then
+	echo "cells-test failed, cells not installed!"
+	exit 1
+fi
 
 sudo cp libcells.so /usr/local/lib
 sudo cp libcells.so /usr/local/lib/libcells.so.1
@@ -0,0 +1,304 @@
+/*
+ * This file memo.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Node memo cache:
+ * Cells_memo_set gives a node a cache of its last input vectors and the
+ * outputs of the ANN for them. If a node runs with an input vector which is
+ * in the cache, the outputs are taken from the cache and the ANN is not
+ * run.
+ *
+ * MEMO_EXACT: the input vector must be bit-identical.
+ * MEMO_QUANT: the inputs are rounded to multiples of "quant" for the key, all
+ * input vectors which round to the same key get the outputs of the first one.
+ *
+ * The cache is split into sets of MEMO_WAYS entries, the hash of the key
+ * selects the set. If the set is full, the oldest entry is replaced:
+ * MEMO_EVICT_LRU: the least recently used entry, MEMO_EVICT_FIFO: the entry
+ * which was added first.
+ *
+ * A node is only run by one thread at a time, so the cache has no locks.
+ * Cells_fann_read_ann removes the cache of the node. A new kernel of the
+ * node (Cells_set_kernel, Cells_set_fast_math, Cells_set_node_weights) or a
+ * change of its int8 layers (quant.c) empties the cache: the cached outputs
+ * are from the old kernel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+#define MEMO_WAYS 4
+#define MEMO_KEY_EXACT 16777216.0	// 2^24: bigger floats are integers already
+
+struct memo
+{
+	S8 sets;				// power of two
+	S8 inputs;
+	S8 outputs;
+	U1 mode;
+	U1 evict;
+	F8 quant;
+	U8 clock;
+	U8 *stamp;				// per entry: last use or insert, 0 = free
+	U8 *hash;				// per entry: hash of the key
+	fann_type *keys;		// per entry: inputs values
+	fann_type *values;		// per entry: outputs values
+	fann_type *key;			// key of the current run
+	S8 hits;
+	S8 misses;
+};
+
+void memo_free (struct memo *memo)
+{
+	if (memo->stamp) cells_free (memo->stamp);
+	if (memo->hash) cells_free (memo->hash);
+	if (memo->keys) cells_free (memo->keys);
+	if (memo->values) cells_free (memo->values);
+	if (memo->key) cells_free (memo->key);
+	cells_free (memo);
+}
+
+void memo_flush (struct memo *memo)
+{
+	// remove all cached outputs, the hits/misses stay
+	if (memo == NULL)
+	{
+		return;
+	}
+
+	memset (memo->stamp, 0, memo->sets * MEMO_WAYS * sizeof (U8));
+	memo->clock = 0;
+}
+
+static struct memo *memo_create (S8 capacity, S8 inputs, S8 outputs, U1 mode, F8 quant, U1 evict)
+{
+	struct memo *memo;
+	S8 entries;
+
+	memo = (struct memo *) cells_calloc (1, sizeof (struct memo));
+	if (memo == NULL)
+	{
+		return (NULL);
+	}
+
+	memo->sets = 1;
+	while (memo->sets * MEMO_WAYS < capacity)
+	{
+		memo->sets *= 2;
+	}
+	entries = memo->sets * MEMO_WAYS;
+
+	memo->inputs = inputs;
+	memo->outputs = outputs;
+	memo->mode = mode;
+	memo->evict = evict;
+	memo->quant = quant;
+
+	memo->stamp = (U8 *) cells_calloc (entries, sizeof (U8));
+	memo->hash = (U8 *) cells_calloc (entries, sizeof (U8));
+	memo->keys = (fann_type *) cells_calloc (entries * inputs + 1, sizeof (fann_type));
+	memo->values = (fann_type *) cells_calloc (entries * outputs + 1, sizeof (fann_type));
+	memo->key = (fann_type *) cells_calloc (inputs + 1, sizeof (fann_type));
+	if (memo->stamp == NULL || memo->hash == NULL || memo->keys == NULL || memo->values == NULL || memo->key == NULL)
+	{
+		memo_free (memo);
+		return (NULL);
+	}
+	return (memo);
+}
+
+static U8 memo_hash (fann_type *key, S8 inputs)
+{
+	// FNV-1a over the key bytes
+	U8 hash = 14695981039346656037ULL;
+	U1 *byte = (U1 *) key;
+	S8 i;
+
+	for (i = 0; i < inputs * (S8) sizeof (fann_type); i++)
+	{
+		hash ^= byte[i];
+		hash *= 1099511628211ULL;
+	}
+	return (hash);
+}
+
+fann_type *memo_run (struct memo *memo, struct fann *ann, struct kernel *kernel, fann_type *input)
+{
+	// run the ANN or take the outputs from the cache
+	fann_type *key;
+	fann_type *output;
+	F8 value;
+	U8 hash;
+	S8 i, set, slot, victim;
+
+	if (memo == NULL)
+	{
+		return (kernel_run (kernel, ann, input));
+	}
+
+	key = input;
+	if (memo->mode == MEMO_QUANT)
+	{
+		key = memo->key;
+		for (i = 0; i < memo->inputs; i++)
+		{
+			// round to the next multiple, as integer: no -0.0 keys
+			value = input[i] / memo->quant;
+			if (value > -MEMO_KEY_EXACT && value < MEMO_KEY_EXACT)
+			{
+				key[i] = (fann_type) (S8) (value < 0.0 ? value - 0.5 : value + 0.5);
+			}
+			else
+			{
+				// big values and NaN: no cast to S8
+				key[i] = (fann_type) value;
+			}
+		}
+	}
+
+	hash = memo_hash (key, memo->inputs);
+	set = (hash & (memo->sets - 1)) * MEMO_WAYS;
+	memo->clock++;
+
+	victim = set;
+	for (slot = set; slot < set + MEMO_WAYS; slot++)
+	{
+		if (memo->stamp[slot] != 0 && memo->hash[slot] == hash
+			&& memcmp (&memo->keys[slot * memo->inputs], key, memo->inputs * sizeof (fann_type)) == 0)
+		{
+			memo->hits++;
+			if (memo->evict == MEMO_EVICT_LRU)
+			{
+				memo->stamp[slot] = memo->clock;
+			}
+			return (&memo->values[slot * memo->outputs]);
+		}
+
+		if (memo->stamp[slot] < memo->stamp[victim])
+		{
+			victim = slot;
+		}
+	}
+
+	memo->misses++;
+	output = kernel_run (kernel, ann, input);
+
+	memo->stamp[victim] = memo->clock;
+	memo->hash[victim] = hash;
+	memcpy (&memo->keys[victim * memo->inputs], key, memo->inputs * sizeof (fann_type));
+	memcpy (&memo->values[victim * memo->outputs], output, memo->outputs * sizeof (fann_type));
+	return (output);
+}
+
+S2 Cells_memo_set (struct cell *cells, S8 cell, S8 node, S8 capacity, U1 mode, F8 quant, U1 evict)
+{
+	// capacity: cached input vectors, 0 = no cache
+	struct neuron *neuron;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("memo_set: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("memo_set: error: node out of range!\n");
+		return (1);
+	}
+
+	neuron = &cells[cell].neurons[node];
+	if (capacity > 0 && neuron->fann_state != ANNOPEN)
+	{
+		printf ("memo_set: error: node has no ANN: cell: %lli, node: %lli!\n", cell, node);
+		return (1);
+	}
+
+	if (mode != MEMO_EXACT && mode != MEMO_QUANT)
+	{
+		printf ("memo_set: error: unknown mode: %i!\n", mode);
+		return (1);
+	}
+
+	if (mode == MEMO_QUANT && quant <= 0.0)
+	{
+		printf ("memo_set: error: quant must be greater than zero!\n");
+		return (1);
+	}
+
+	if (evict != MEMO_EVICT_LRU && evict != MEMO_EVICT_FIFO)
+	{
+		printf ("memo_set: error: unknown eviction: %i!\n", evict);
+		return (1);
+	}
+
+	if (neuron->memo != NULL)
+	{
+		memo_free (neuron->memo);
+		neuron->memo = NULL;
+	}
+
+	if (capacity > 0)
+	{
+		neuron->memo = memo_create (capacity, neuron->inputs, neuron->outputs, mode, quant, evict);
+		if (neuron->memo == NULL)
+		{
+			printf ("memo_set: out of memory, allocating cache!\n");
+			return (1);
+		}
+	}
+
+	cells[cell].topology++;
+	return (0);
+}
+
+S2 Cells_memo_stats (struct cell *cells, S8 cell, S8 node, S8 *hits, S8 *misses)
+{
+	struct neuron *neuron;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("memo_stats: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (node < 0 || node >= cells[cell].neurons_max)
+	{
+		printf ("memo_stats: error: node out of range!\n");
+		return (1);
+	}
+
+	neuron = &cells[cell].neurons[node];
+	if (neuron->memo == NULL)
+	{
+		*hits = 0;
+		*misses = 0;
+		return (0);
+	}
+
+	*hits = neuron->memo->hits;
+	*misses = neuron->memo->misses;
+	return (0);
+}
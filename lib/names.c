@@ -0,0 +1,278 @@
+/*
+ * This file names.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Name table:
+ * The ANN file names of all nodes are kept in one table of the graph, in
+ * cells[0]. Every name is stored once, the nodes only have the ID of their
+ * name. ID 0 is the empty name, so a node without a name has ID 0.
+ *
+ * The names are packed one after the other into a text buffer, the IDs give
+ * the offset of a name in this buffer. A hash table with open addressing
+ * maps the names to their IDs.
+ *
+ * The fann_name field of struct neuron keeps a copy of the name for old
+ * programs, cut to MAXFANNNAME - 1 characters. The library only reads the
+ * name table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+#define NAMES_START 64			// first size of the ID and hash tables
+#define NAMES_TEXT_START 4096	// first size of the text buffer
+
+struct names
+{
+	S8 names_max;			// size of offset
+	S8 names;				// used IDs
+	S8 *offset;				// text offset of every ID
+	S8 hash_max;			// power of two, at least twice names_max
+	S8 *hash;				// ID + 1 of a name, 0 = free
+	S8 text_max;
+	S8 text_len;
+	U1 *text;
+};
+
+static U8 names_hash (U1 *name)
+{
+	// FNV-1a
+	U8 hash = 14695981039346656037ULL;
+
+	while (*name != '\0')
+	{
+		hash ^= *name;
+		hash *= 1099511628211ULL;
+		name++;
+	}
+	return (hash);
+}
+
+static S8 names_find (struct names *names, U1 *name)
+{
+	// hash slot of the name, or the free slot where it belongs
+	S8 slot;
+
+	slot = names_hash (name) & (names->hash_max - 1);
+	while (names->hash[slot] != 0)
+	{
+		if (strcmp ((const char *) &names->text[names->offset[names->hash[slot] - 1]], (const char *) name) == 0)
+		{
+			break;
+		}
+		slot = (slot + 1) & (names->hash_max - 1);
+	}
+	return (slot);
+}
+
+static S2 names_grow_ids (struct names *names)
+{
+	S8 *offset;
+	S8 *hash;
+	S8 i, slot;
+
+	offset = (S8 *) cells_calloc (names->names_max * 2, sizeof (S8));
+	hash = (S8 *) cells_calloc (names->hash_max * 2, sizeof (S8));
+	if (offset == NULL || hash == NULL)
+	{
+		if (offset) cells_free (offset);
+		if (hash) cells_free (hash);
+		return (1);
+	}
+
+	memcpy (offset, names->offset, names->names * sizeof (S8));
+	cells_free (names->offset);
+	cells_free (names->hash);
+
+	names->offset = offset;
+	names->names_max *= 2;
+	names->hash = hash;
+	names->hash_max *= 2;
+
+	// rehash all names
+	for (i = 0; i < names->names; i++)
+	{
+		slot = names_find (names, &names->text[names->offset[i]]);
+		names->hash[slot] = i + 1;
+	}
+	return (0);
+}
+
+static S2 names_grow_text (struct names *names, S8 len)
+{
+	U1 *text;
+	S8 text_max;
+
+	text_max = names->text_max * 2;
+	while (text_max < names->text_len + len)
+	{
+		text_max *= 2;
+	}
+
+	text = (U1 *) cells_calloc (text_max, sizeof (U1));
+	if (text == NULL)
+	{
+		return (1);
+	}
+
+	memcpy (text, names->text, names->text_len);
+	cells_free (names->text);
+	names->text = text;
+	names->text_max = text_max;
+	return (0);
+}
+
+static struct names *names_create (void)
+{
+	struct names *names;
+
+	names = (struct names *) cells_calloc (1, sizeof (struct names));
+	if (names == NULL)
+	{
+		return (NULL);
+	}
+
+	names->names_max = NAMES_START;
+	names->hash_max = NAMES_START * 2;
+	names->text_max = NAMES_TEXT_START;
+	names->offset = (S8 *) cells_calloc (names->names_max, sizeof (S8));
+	names->hash = (S8 *) cells_calloc (names->hash_max, sizeof (S8));
+	names->text = (U1 *) cells_calloc (names->text_max, sizeof (U1));
+	if (names->offset == NULL || names->hash == NULL || names->text == NULL)
+	{
+		names_free (names);
+		return (NULL);
+	}
+
+	// ID 0: the empty name, set by calloc
+	names->names = 1;
+	names->text_len = 1;
+	names->hash[names_find (names, (U1 *) "")] = 1;
+	return (names);
+}
+
+void names_free (struct names *names)
+{
+	if (names->offset) cells_free (names->offset);
+	if (names->hash) cells_free (names->hash);
+	if (names->text) cells_free (names->text);
+	cells_free (names);
+}
+
+S2 names_intern (struct cell *cells, U1 *name, S8 *id)
+{
+	// get the ID of a name, the name is added to the table if it is new
+	struct names *names;
+	S8 slot, len;
+
+	if (cells[0].names == NULL)
+	{
+		cells[0].names = names_create ();
+		if (cells[0].names == NULL)
+		{
+			printf ("names_intern: out of memory, allocating name table!\n");
+			return (1);
+		}
+	}
+	names = cells[0].names;
+
+	slot = names_find (names, name);
+	if (names->hash[slot] != 0)
+	{
+		*id = names->hash[slot] - 1;
+		return (0);
+	}
+
+	if (names->names == names->names_max)
+	{
+		if (names_grow_ids (names) != 0)
+		{
+			printf ("names_intern: out of memory, allocating name IDs!\n");
+			return (1);
+		}
+		slot = names_find (names, name);
+	}
+
+	len = strlen ((const char *) name) + 1;
+	if (names->text_len + len > names->text_max)
+	{
+		if (names_grow_text (names, len) != 0)
+		{
+			printf ("names_intern: out of memory, allocating name text!\n");
+			return (1);
+		}
+	}
+
+	memcpy (&names->text[names->text_len], name, len);
+	names->offset[names->names] = names->text_len;
+	names->text_len += len;
+	names->hash[slot] = names->names + 1;
+
+	*id = names->names;
+	names->names++;
+	return (0);
+}
+
+U1 *names_get (struct cell *cells, S8 id)
+{
+	// name of an ID, unknown IDs give the empty name
+	struct names *names;
+
+	names = cells[0].names;
+	if (names == NULL || id < 0 || id >= names->names)
+	{
+		return ((U1 *) "");
+	}
+	return (&names->text[names->offset[id]]);
+}
+
+void names_set_node (struct cell *cells, S8 cell, S8 node, S8 id)
+{
+	// set the name ID of a node and the copy in the node
+	cells[cell].cold[node].fann_name = id;
+	strncpy ((char *) cells[cell].neurons[node].fann_name, (const char *) names_get (cells, id), MAXFANNNAME - 1);
+	cells[cell].neurons[node].fann_name[MAXFANNNAME - 1] = '\0';
+}
+
+S8 names_count (struct cell *cells)
+{
+	// number of IDs, with the empty name
+	if (cells[0].names == NULL)
+	{
+		return (1);
+	}
+	return (cells[0].names->names);
+}
+
+S8 Cells_names_bytes (struct cell *cells)
+{
+	// memory used by the name table
+	struct names *names;
+
+	if (cells == NULL || cells[0].names == NULL)
+	{
+		return (0);
+	}
+	names = cells[0].names;
+	return (sizeof (struct names) + names->names_max * sizeof (S8) + names->hash_max * sizeof (S8) + names->text_max);
+}
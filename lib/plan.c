@@ -0,0 +1,908 @@
+/*
+ * This file plan.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compiled execution plan:
+ * Cells_compile_plan checks all links of a cell once and builds a flat list
+ * of the ANN nodes sorted by layer (and node number inside a layer, the same
+ * order as in Cells_fann_run_ann_go_links). Every entry has the range of its
+ * links in one flat links array. Cells_run_plan walks this list without
+ * scanning all nodes for every layer.
+ *
+ * The plan links are compact 8 byte links (struct plan_link) sorted by the
+ * source entry, their node is the plan entry of the linked node. Links with
+ * an input or output above 65535 can't be compiled. The ANN, sizes and buffers of the
+ * entries are copied into parallel arrays, so a run doesn't load the node
+ * structures at all.
+ *
+ * The plan is compiled again if the cell "topology" counter changed, this is
+ * done by all functions which change nodes or links.
+ *
+ * Incremental run:
+ * Cells_fann_do_update_ann marks the node dirty in the plan, a new plan has
+ * all nodes dirty. Cells_run_plan_dirty only runs the dirty nodes. If the
+ * outputs of a node are not bit-identical to its last outputs, the links are
+ * copied and the linked nodes become dirty too, else the propagation stops
+ * at this node. Every other run of a node clears its dirty flag, only a
+ * fused chain run marks its inner nodes PLAN_STALE: their outputs are not
+ * set, so the next incremental run takes them as changed.
+ *
+ * Link ranges:
+ * The links of an entry are sorted by the linked entry and input, links to
+ * the next input from the next output are merged to one range, which is
+ * copied with memcpy. Links to the same input keep their order, so the last
+ * one still sets the input.
+ *
+ * With FUSION_LINKS a node whose inputs are all set by one range from a node
+ * of an earlier layer gets no copy at all: its plan inputs point to the
+ * outputs of the linked node. The own inputs buffer of the node is not set
+ * then, and Cells_fann_do_update_ann on it doesn't change the plan runs.
+ *
+ * The inputs/outputs of nodes bound to caller buffers point into these
+ * buffers, see bind.c.
+ *
+ * With FUSION_CHAINS and FUSION_GROUPS the plan also has the fused chains
+ * of linked nodes and the groups of same-shape nodes, see fuse.c.
+ *
+ * After Cells_pack_weights a run prefetches the weights of the next kernel
+ * from the weights slab, see slab.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+
+static int plan_entry_cmp (const void *a, const void *b)
+{
+	const struct plan_entry *entry_a = a;
+	const struct plan_entry *entry_b = b;
+
+	if (entry_a->layer != entry_b->layer)
+	{
+		return (entry_a->layer < entry_b->layer ? -1 : 1);
+	}
+	if (entry_a->node != entry_b->node)
+	{
+		return (entry_a->node < entry_b->node ? -1 : 1);
+	}
+	return (0);
+}
+
+struct range_link
+{
+	S8 node;
+	S8 input;
+	S8 output;
+	S8 index;				// links to the same input keep their order
+};
+
+static int range_link_cmp (const void *a, const void *b)
+{
+	const struct range_link *link_a = a;
+	const struct range_link *link_b = b;
+
+	if (link_a->node != link_b->node)
+	{
+		return (link_a->node < link_b->node ? -1 : 1);
+	}
+	if (link_a->input != link_b->input)
+	{
+		return (link_a->input < link_b->input ? -1 : 1);
+	}
+	if (link_a->index != link_b->index)
+	{
+		return (link_a->index < link_b->index ? -1 : 1);
+	}
+	return (0);
+}
+
+static U1 node_runnable (struct neuron *neuron)
+{
+	if (neuron->type == ANN && neuron->fann_state == ANNOPEN && neuron->inputs_nodef != NULL && neuron->outputs_nodef != NULL && neuron->inputs_f != NULL)
+	{
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+static void plan_destroy (struct plan *plan)
+{
+	if (plan->entries) cells_free (plan->entries);
+	if (plan->links) cells_free (plan->links);
+	if (plan->layers) cells_free (plan->layers);
+	if (plan->node_entry) cells_free (plan->node_entry);
+	if (plan->ann) cells_free (plan->ann);
+	if (plan->memo) cells_free (plan->memo);
+	if (plan->kernel) cells_free (plan->kernel);
+	if (plan->inputs) cells_free (plan->inputs);
+	if (plan->outputs) cells_free (plan->outputs);
+	if (plan->inputs_nodef) cells_free (plan->inputs_nodef);
+	if (plan->outputs_nodef) cells_free (plan->outputs_nodef);
+	if (plan->inputs_f) cells_free (plan->inputs_f);
+	if (plan->outputs_f) cells_free (plan->outputs_f);
+	if (plan->dirty) cells_free (plan->dirty);
+	if (plan->batch) batch_free (plan->batch);
+	if (plan->ranges) cells_free (plan->ranges);
+	if (plan->alias) cells_free (plan->alias);
+	if (plan->alias_output) cells_free (plan->alias_output);
+	if (plan->pulls) cells_free (plan->pulls);
+	if (plan->pull_groups) cells_free (plan->pull_groups);
+	if (plan->fuse) fuse_free (plan->fuse);
+	if (plan->prefetch) cells_free (plan->prefetch);
+	plan_cones_free (plan);
+	cells_free (plan);
+}
+
+void plan_free (struct cell *cells, S8 cell)
+{
+	if (cells[cell].plan == NULL)
+	{
+		return;
+	}
+
+	plan_destroy (cells[cell].plan);
+	cells[cell].plan = NULL;
+}
+
+static S2 plan_ranges (struct plan *plan, struct neuron *neurons, U1 alias)
+{
+	// merge the links of every entry to ranges, alias: inputs in the outputs of one linked node
+	struct range_link *sort;
+	struct plan_range *range;
+	S8 *incoming;
+	S8 e, f, j, r, w, links;
+
+	plan->ranges = (struct plan_range *) cells_calloc (plan->links_max + 1, sizeof (struct plan_range));
+	plan->alias = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	plan->alias_output = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	sort = (struct range_link *) cells_calloc (plan->links_max + 1, sizeof (struct range_link));
+	incoming = (S8 *) cells_calloc (plan->entries_max + 1, sizeof (S8));
+	if (plan->ranges == NULL || plan->alias == NULL || plan->alias_output == NULL || sort == NULL || incoming == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating link ranges!\n");
+		if (sort) cells_free (sort);
+		if (incoming) cells_free (incoming);
+		return (1);
+	}
+
+	r = 0;
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		plan->alias[e] = -1;
+		links = 0;
+		for (j = plan->entries[e].link_start; j < plan->entries[e].link_end; j++)
+		{
+			sort[links].node = plan->links[j].node;
+			sort[links].input = plan->links[j].node_input;
+			sort[links].output = plan->links[j].node_output;
+			sort[links].index = links;
+			links++;
+		}
+		qsort (sort, links, sizeof (struct range_link), range_link_cmp);
+
+		plan->entries[e].range_start = r;
+		for (j = 0; j < links; j++)
+		{
+			if (r > plan->entries[e].range_start)
+			{
+				range = &plan->ranges[r - 1];
+				if (range->node == sort[j].node && range->input + range->count == sort[j].input && range->output + range->count == sort[j].output)
+				{
+					range->count++;
+					continue;
+				}
+			}
+
+			range = &plan->ranges[r];
+			range->node = sort[j].node;
+			range->input = sort[j].input;
+			range->output = sort[j].output;
+			range->count = 1;
+			incoming[range->node]++;
+			r++;
+		}
+		plan->entries[e].range_end = r;
+	}
+
+	// alias: drop the only range to all inputs of an entry of a later layer, if they are not bound
+	w = 0;
+	for (e = 0; e < plan->entries_max; e++)
+	{
+		r = plan->entries[e].range_start;
+		plan->entries[e].range_start = w;
+		for (; r < plan->entries[e].range_end; r++)
+		{
+			range = &plan->ranges[r];
+			f = range->node;
+			if (alias == TRUE && incoming[f] == 1 && range->input == 0 && range->count == plan->inputs[f]
+				&& plan->entries[e].layer < plan->entries[f].layer
+				&& plan->inputs_f[f] == neurons[plan->entries[f].node].inputs_f && plan->inputs_nodef[f] == neurons[plan->entries[f].node].inputs_nodef)
+			{
+				// STORAGE_F8: inputs_f stays the staging buffer of the node
+				if (plan->storage == STORAGE_FANN)
+				{
+					plan->inputs_f[f] = plan->outputs_f[e] + range->output;
+				}
+				else
+				{
+					plan->inputs_nodef[f] = plan->outputs_nodef[e] + range->output;
+				}
+				plan->alias[f] = e;
+				plan->alias_output[f] = range->output;
+				plan->aliases_max++;
+				continue;
+			}
+			plan->ranges[w] = *range;
+			w++;
+		}
+		plan->entries[e].range_end = w;
+	}
+	plan->ranges_max = w;
+
+	cells_free (sort);
+	cells_free (incoming);
+	return (0);
+}
+
+static int plan_pull_cmp (const void *a, const void *b)
+{
+	const struct plan_pull *pull_a = a;
+	const struct plan_pull *pull_b = b;
+
+	if (pull_a->node != pull_b->node)
+	{
+		return (pull_a->node < pull_b->node ? -1 : 1);
+	}
+	if (pull_a->range != pull_b->range)
+	{
+		return (pull_a->range < pull_b->range ? -1 : 1);
+	}
+	return (0);
+}
+
+static S2 plan_pulls (struct plan *plan)
+{
+	// group the ranges of every layer by the linked entry: the threaded run copies one group per thread,
+	// so two nodes linked to the same input are never copied at once. In a group the ranges keep
+	// the plan order, the last link wins like in plan_copy_links
+	S8 l, e, r, p, g, start;
+
+	plan->pulls = (struct plan_pull *) cells_calloc (plan->ranges_max + 1, sizeof (struct plan_pull));
+	plan->pull_groups = (S8 *) cells_calloc (plan->ranges_max + 2, sizeof (S8));
+	if (plan->pulls == NULL || plan->pull_groups == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating link groups!\n");
+		return (1);
+	}
+
+	p = 0;
+	g = 0;
+	for (l = 0; l < plan->layers_max; l++)
+	{
+		start = p;
+		for (e = plan->layers[l].entry_start; e < plan->layers[l].entry_end; e++)
+		{
+			for (r = plan->entries[e].range_start; r < plan->entries[e].range_end; r++)
+			{
+				plan->pulls[p].node = plan->ranges[r].node;
+				plan->pulls[p].entry = e;
+				plan->pulls[p].range = r;
+				p++;
+			}
+		}
+		qsort (&plan->pulls[start], p - start, sizeof (struct plan_pull), plan_pull_cmp);
+
+		plan->layers[l].group_start = g;
+		for (r = start; r < p; r++)
+		{
+			if (r == start || plan->pulls[r].node != plan->pulls[r - 1].node)
+			{
+				plan->pull_groups[g] = r;
+				g++;
+			}
+		}
+		plan->layers[l].group_end = g;
+	}
+	plan->pull_groups[g] = p;
+	return (0);
+}
+
+static S2 compile_cell (struct cell *cells, S8 cell)
+{
+	struct plan *plan;
+	struct neuron *neurons;
+	struct neuron *neuron;
+	S8 n, j, e, l;
+	S8 entries = 0, links = 0, layers = 0;
+	S8 link_node, node_input, node_output;
+
+	neurons = cells[cell].neurons;
+	if (neurons == NULL)
+	{
+		printf ("compile_plan: error: no nodes allocated: cell: %lli!\n", cell);
+		return (1);
+	}
+
+	// check links and count the nodes to run
+	for (n = 0; n < cells[cell].neurons_max; n++)
+	{
+		if (node_runnable (&neurons[n]) == FALSE)
+		{
+			continue;
+		}
+
+		entries++;
+
+		if (neurons[n].links_max > 0 && neurons[n].links == NULL)
+		{
+			printf ("compile_plan: error: no links allocated: cell: %lli, node: %lli!\n", cell, n);
+			return (1);
+		}
+
+		for (j = 0; j < neurons[n].links_max; j++)
+		{
+			link_node = neurons[n].links[j].node;
+			node_input = neurons[n].links[j].node_input;
+			node_output = neurons[n].links[j].node_output;
+
+			if (link_node < 0 || link_node >= cells[cell].neurons_max)
+			{
+				printf ("compile_plan: error: link node out of range: cell: %lli, node: %lli, link: %lli!\n", cell, n, j);
+				return (1);
+			}
+
+			if (node_runnable (&neurons[link_node]) == FALSE)
+			{
+				printf ("compile_plan: error: linked node has no ANN: cell: %lli, node: %lli, link: %lli!\n", cell, n, j);
+				return (1);
+			}
+
+			if (node_input < 0 || node_input >= neurons[link_node].inputs)
+			{
+				printf ("compile_plan: error: link input overflow: cell: %lli, node: %lli, link: %lli!\n", cell, n, j);
+				return (1);
+			}
+
+			if (node_input > PLAN_LINK_PORT_MAX || node_output > PLAN_LINK_PORT_MAX)
+			{
+				printf ("compile_plan: error: link input/output above %lli: cell: %lli, node: %lli, link: %lli!\n", PLAN_LINK_PORT_MAX, cell, n, j);
+				return (1);
+			}
+
+			if (node_output < 0 || node_output >= neurons[n].outputs)
+			{
+				printf ("compile_plan: error: link output overflow: cell: %lli, node: %lli, link: %lli!\n", cell, n, j);
+				return (1);
+			}
+		}
+		links += neurons[n].links_max;
+	}
+
+	if (entries > PLAN_LINK_NODE_MAX)
+	{
+		printf ("compile_plan: error: too many nodes for links: cell: %lli!\n", cell);
+		return (1);
+	}
+
+	plan = (struct plan *) cells_calloc (1, sizeof (struct plan));
+	if (plan == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating plan!\n");
+		return (1);
+	}
+
+	// one more element, so nothing has a size of zero
+	plan->entries = (struct plan_entry *) cells_calloc (entries + 1, sizeof (struct plan_entry));
+	plan->layers = (struct plan_layer *) cells_calloc (entries + 1, sizeof (struct plan_layer));
+	plan->links = (struct plan_link *) cells_calloc (links + 1, sizeof (struct plan_link));
+	plan->node_entry = (S8 *) cells_calloc (cells[cell].neurons_max + 1, sizeof (S8));
+	plan->ann = (struct fann **) cells_calloc (entries + 1, sizeof (struct fann *));
+	plan->memo = (struct memo **) cells_calloc (entries + 1, sizeof (struct memo *));
+	plan->kernel = (struct kernel **) cells_calloc (entries + 1, sizeof (struct kernel *));
+	plan->inputs = (S8 *) cells_calloc (entries + 1, sizeof (S8));
+	plan->outputs = (S8 *) cells_calloc (entries + 1, sizeof (S8));
+	plan->inputs_nodef = (F8 **) cells_calloc (entries + 1, sizeof (F8 *));
+	plan->outputs_nodef = (F8 **) cells_calloc (entries + 1, sizeof (F8 *));
+	plan->inputs_f = (fann_type **) cells_calloc (entries + 1, sizeof (fann_type *));
+	plan->outputs_f = (fann_type **) cells_calloc (entries + 1, sizeof (fann_type *));
+	plan->dirty = (U1 *) cells_calloc (entries + 1, sizeof (U1));
+	plan->prefetch = (struct kernel **) cells_calloc (entries + 1, sizeof (struct kernel *));
+
+	if (plan->entries == NULL || plan->layers == NULL || plan->links == NULL || plan->node_entry == NULL
+		|| plan->ann == NULL || plan->memo == NULL || plan->kernel == NULL || plan->inputs == NULL || plan->outputs == NULL || plan->inputs_nodef == NULL
+		|| plan->outputs_nodef == NULL || plan->inputs_f == NULL || plan->outputs_f == NULL || plan->dirty == NULL || plan->prefetch == NULL)
+	{
+		printf ("compile_plan: out of memory, allocating plan entries!\n");
+		plan_destroy (plan);
+		return (1);
+	}
+
+	for (n = 0; n < cells[cell].neurons_max; n++)
+	{
+		plan->node_entry[n] = -1;
+	}
+
+	e = 0;
+	for (n = 0; n < cells[cell].neurons_max; n++)
+	{
+		if (node_runnable (&neurons[n]) == TRUE)
+		{
+			plan->entries[e].node = n;
+			plan->entries[e].layer = neurons[n].layer;
+			e++;
+		}
+	}
+
+	// topological order: by layer, inside a layer by node number
+	qsort (plan->entries, entries, sizeof (struct plan_entry), plan_entry_cmp);
+
+	for (e = 0; e < entries; e++)
+	{
+		n = plan->entries[e].node;
+		neuron = &neurons[n];
+		plan->node_entry[n] = e;
+
+		plan->ann[e] = neuron->ann;
+		plan->memo[e] = neuron->memo;
+		plan->kernel[e] = neuron->kernel;
+		plan->inputs[e] = neuron->inputs;
+		plan->outputs[e] = neuron->outputs;
+		plan->inputs_nodef[e] = neuron->inputs_nodef;
+		plan->outputs_nodef[e] = neuron->outputs_nodef;
+		plan->inputs_f[e] = neuron->inputs_f;
+		plan->outputs_f[e] = neuron->outputs_f;
+
+		// new plan: all nodes must run once
+		plan->dirty[e] = 1;
+	}
+
+	l = 0;
+	for (e = 0; e < entries; e++)
+	{
+		n = plan->entries[e].node;
+
+		// the plan links point to plan entries, not to nodes
+		plan->entries[e].link_start = l;
+		for (j = 0; j < neurons[n].links_max; j++)
+		{
+			plan->links[l].node = plan->node_entry[neurons[n].links[j].node];
+			plan->links[l].node_input = neurons[n].links[j].node_input;
+			plan->links[l].node_output = neurons[n].links[j].node_output;
+			l++;
+		}
+		plan->entries[e].link_end = l;
+
+		if (e == 0 || plan->entries[e].layer != plan->entries[e - 1].layer)
+		{
+			plan->layers[layers].layer = plan->entries[e].layer;
+			plan->layers[layers].entry_start = e;
+			layers++;
+		}
+		plan->layers[layers - 1].entry_end = e + 1;
+	}
+
+	plan->entries_max = entries;
+	plan->links_max = links;
+	plan->layers_max = layers;
+	plan->topology = cells[cell].topology;
+	plan->storage = cells[cell].storage;
+
+	if (bind_plan (cells, cell, plan) != 0 || plan_ranges (plan, neurons, (cells[cell].fusion & FUSION_LINKS) != 0) != 0 || plan_pulls (plan) != 0)
+	{
+		plan_destroy (plan);
+		return (1);
+	}
+
+	if ((cells[cell].fusion & (FUSION_CHAINS | FUSION_GROUPS)) != 0 && fuse_plan (plan, cells[cell].fusion) != 0)
+	{
+		plan_destroy (plan);
+		return (1);
+	}
+	slab_plan (plan);
+
+	plan_free (cells, cell);
+	cells[cell].plan = plan;
+	return (0);
+}
+
+S2 plan_check (struct cell *cells, S8 cell)
+{
+	// compile the plan of a cell, if it is missing or out of date
+
+	if (cells[cell].plan != NULL && cells[cell].plan->topology == cells[cell].topology)
+	{
+		return (0);
+	}
+	return (compile_cell (cells, cell));
+}
+
+S2 Cells_compile_plan (struct cell *cells, S8 start_cell, S8 end_cell)
+{
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("compile_plan: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (compile_cell (cells, i) != 0)
+		{
+			printf ("compile_plan: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+	}
+	return (0);
+}
+
+S2 Cells_link_ranges (struct cell *cells, S8 cell, S8 *links, S8 *ranges, S8 *aliases)
+{
+	// links of a cell, the range copies they are merged to and the entries with aliased inputs
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("link_ranges: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (plan_check (cells, cell) != 0)
+	{
+		printf ("link_ranges: error compiling cell: %lli!\n", cell);
+		return (1);
+	}
+
+	*links = cells[cell].plan->links_max;
+	*ranges = cells[cell].plan->ranges_max;
+	*aliases = cells[cell].plan->aliases_max;
+	return (0);
+}
+
+S2 plan_run_entry (struct plan *plan, S8 e)
+{
+	// run the ANN of a plan entry, only the hot plan arrays are used
+	fann_type *input_f;
+	fann_type *output_f;
+	F8 *input_nodef;
+	F8 *output_nodef;
+	S8 i;
+
+	input_f = plan->inputs_f[e];
+	plan->dirty[e] = 0;
+
+	if (plan->storage == STORAGE_FANN)
+	{
+		output_f = memo_run (plan->memo[e], plan->ann[e], plan->kernel[e], input_f);
+		memcpy (plan->outputs_f[e], output_f, plan->outputs[e] * sizeof (fann_type));
+		return (0);
+	}
+
+	input_nodef = plan->inputs_nodef[e];
+	for (i = 0; i < plan->inputs[e]; i++)
+	{
+		input_f[i] = input_nodef[i];
+	}
+
+	output_f = memo_run (plan->memo[e], plan->ann[e], plan->kernel[e], input_f);
+
+	output_nodef = plan->outputs_nodef[e];
+	for (i = 0; i < plan->outputs[e]; i++)
+	{
+		output_nodef[i] = output_f[i];
+	}
+	return (0);
+}
+
+void plan_copy_links (struct plan *plan, S8 e)
+{
+	// copy the outputs of a plan entry to the linked inputs, one range at a time
+	struct plan_entry *entry;
+	struct plan_range *range;
+	fann_type *output_f;
+	F8 *output_nodef;
+	S8 r;
+
+	entry = &plan->entries[e];
+
+	if (plan->storage == STORAGE_FANN)
+	{
+		output_f = plan->outputs_f[e];
+		for (r = entry->range_start; r < entry->range_end; r++)
+		{
+			range = &plan->ranges[r];
+			memcpy (&plan->inputs_f[range->node][range->input], &output_f[range->output], range->count * sizeof (fann_type));
+		}
+		return;
+	}
+
+	output_nodef = plan->outputs_nodef[e];
+	for (r = entry->range_start; r < entry->range_end; r++)
+	{
+		range = &plan->ranges[r];
+		memcpy (&plan->inputs_nodef[range->node][range->input], &output_nodef[range->output], range->count * sizeof (F8));
+	}
+}
+
+void plan_pull_links (struct plan *plan, S8 group, S8 start_layer, S8 end_layer)
+{
+	// copy the ranges of a pull group, all to the inputs of one entry
+	struct plan_pull *pull;
+	struct plan_range *range;
+	S8 p;
+
+	for (p = plan->pull_groups[group]; p < plan->pull_groups[group + 1]; p++)
+	{
+		pull = &plan->pulls[p];
+		if (fuse_inner (plan, pull->entry, start_layer, end_layer) == TRUE)
+		{
+			continue;
+		}
+		range = &plan->ranges[pull->range];
+		if (plan->storage == STORAGE_FANN)
+		{
+			memcpy (&plan->inputs_f[range->node][range->input], &plan->outputs_f[pull->entry][range->output], range->count * sizeof (fann_type));
+		}
+		else
+		{
+			memcpy (&plan->inputs_nodef[range->node][range->input], &plan->outputs_nodef[pull->entry][range->output], range->count * sizeof (F8));
+		}
+	}
+}
+
+static U1 plan_run_entry_dirty (struct plan *plan, S8 e)
+{
+	// run a dirty plan entry, returns TRUE if an output changed
+	fann_type *input_f;
+	fann_type *output_f;
+	F8 *input_nodef;
+	F8 *output_nodef;
+	F8 value;
+	U1 changed = FALSE;
+	S8 i;
+
+	// old outputs of a fused chain node can't be compared
+	if (plan->dirty[e] == PLAN_STALE)
+	{
+		changed = TRUE;
+	}
+
+	input_f = plan->inputs_f[e];
+	plan->dirty[e] = 0;
+
+	if (plan->storage == STORAGE_FANN)
+	{
+		output_f = memo_run (plan->memo[e], plan->ann[e], plan->kernel[e], input_f);
+		if (changed == TRUE || memcmp (plan->outputs_f[e], output_f, plan->outputs[e] * sizeof (fann_type)) != 0)
+		{
+			memcpy (plan->outputs_f[e], output_f, plan->outputs[e] * sizeof (fann_type));
+			changed = TRUE;
+		}
+		return (changed);
+	}
+
+	input_nodef = plan->inputs_nodef[e];
+	for (i = 0; i < plan->inputs[e]; i++)
+	{
+		input_f[i] = input_nodef[i];
+	}
+
+	output_f = memo_run (plan->memo[e], plan->ann[e], plan->kernel[e], input_f);
+
+	output_nodef = plan->outputs_nodef[e];
+	for (i = 0; i < plan->outputs[e]; i++)
+	{
+		value = output_f[i];
+		if (changed == TRUE || memcmp (&output_nodef[i], &value, sizeof (F8)) != 0)
+		{
+			output_nodef[i] = value;
+			changed = TRUE;
+		}
+	}
+	return (changed);
+}
+
+void plan_mark_dirty (struct cell *cells, S8 cell, S8 node)
+{
+	// node inputs changed: run it on the next Cells_run_plan_dirty
+	struct plan *plan;
+
+	plan = cells[cell].plan;
+
+	// an old plan is compiled again, then all nodes are dirty
+	if (plan == NULL || plan->topology != cells[cell].topology)
+	{
+		return;
+	}
+
+	// a PLAN_STALE entry stays stale
+	if (plan->node_entry[node] >= 0 && plan->dirty[plan->node_entry[node]] == 0)
+	{
+		plan->dirty[plan->node_entry[node]] = 1;
+	}
+}
+
+static void plan_run_cell_dirty (struct cell *cells, S8 cell, S8 start_layer, S8 end_layer)
+{
+	S8 e, j, l;
+	struct plan *plan;
+	struct plan_entry *entry;
+
+	plan = cells[cell].plan;
+
+	for (l = 0; l < plan->layers_max; l++)
+	{
+		if (plan->layers[l].layer < start_layer)
+		{
+			continue;
+		}
+		if (plan->layers[l].layer > end_layer)
+		{
+			break;
+		}
+
+		for (e = plan->layers[l].entry_start; e < plan->layers[l].entry_end; e++)
+		{
+			if (plan->dirty[e] == 0)
+			{
+				continue;
+			}
+
+			// same outputs: the linked nodes don't need to run again
+			if (plan_run_entry_dirty (plan, e) == FALSE)
+			{
+				continue;
+			}
+
+			plan_copy_links (plan, e);
+
+			entry = &plan->entries[e];
+			for (j = entry->link_start; j < entry->link_end; j++)
+			{
+				if (plan->dirty[plan->links[j].node] == 0)
+				{
+					plan->dirty[plan->links[j].node] = 1;
+				}
+			}
+		}
+	}
+}
+
+S2 Cells_run_plan_dirty (struct cell *cells, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
+{
+	// incremental run: only the dirty nodes and the nodes their changed outputs are linked to
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_plan_dirty: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (plan_check (cells, i) != 0)
+		{
+			printf ("run_plan_dirty: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+
+		plan_run_cell_dirty (cells, i, start_layer, end_layer);
+	}
+	return (0);
+}
+
+S2 plan_run_cell (struct cell *cells, S8 cell, S8 start_layer, S8 end_layer)
+{
+	// run the compiled plan of one cell, the plan must be checked before!
+	return (plan_run (cells[cell].plan, start_layer, end_layer));
+}
+
+S2 plan_run_node (struct plan *plan, S8 e, S8 start_layer, S8 end_layer)
+{
+	// run a plan entry as in a whole run, without the links: fused chains and groups, weights prefetch
+
+	// weights slab: load the next kernel while this one runs
+	kernel_prefetch (plan->prefetch[e]);
+
+	if (fuse_whole (plan, e, start_layer, end_layer) == TRUE)
+	{
+		// a chain runs at its last node
+		if (plan->fuse->tail[plan->fuse->head[e]] == e)
+		{
+			fuse_run (plan, plan->fuse->head[e]);
+		}
+		return (0);
+	}
+
+	if (fuse_grouped (plan, e) == TRUE)
+	{
+		// the group ran at its first node
+		return (0);
+	}
+
+	return (plan_run_entry (plan, e));
+}
+
+S2 plan_run (struct plan *plan, S8 start_layer, S8 end_layer)
+{
+	// run a plan: of a cell or of a run context
+	S8 e, l;
+
+	for (l = 0; l < plan->layers_max; l++)
+	{
+		if (plan->layers[l].layer < start_layer)
+		{
+			continue;
+		}
+		if (plan->layers[l].layer > end_layer)
+		{
+			break;
+		}
+
+		for (e = plan->layers[l].entry_start; e < plan->layers[l].entry_end; e++)
+		{
+			if (plan_run_node (plan, e, start_layer, end_layer) != 0)
+			{
+				printf ("run_plan: error running ANN!\n");
+				return (1);
+			}
+
+			// the inner nodes of a chain have no outputs to copy
+			if (fuse_inner (plan, e, start_layer, end_layer) == FALSE)
+			{
+				plan_copy_links (plan, e);
+			}
+		}
+	}
+	return (0);
+}
+
+S2 Cells_run_plan (struct cell *cells, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
+{
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_plan: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (plan_check (cells, i) != 0)
+		{
+			printf ("run_plan: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+
+		if (plan_run_cell (cells, i, start_layer, end_layer) != 0)
+		{
+			return (1);
+		}
+	}
+	return (0);
+}
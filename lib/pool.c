@@ -0,0 +1,619 @@
+/*
+ * This file pool.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Thread pool:
+ * The worker threads are started once by Cells_pool_create and sleep until
+ * a job is given by pool_run. The calling thread works as thread 0 on every
+ * job, so a pool of 16 threads starts 15 workers.
+ *
+ * Cells_run_plan_threads runs the nodes of one layer on all threads. The
+ * nodes of a layer don't depend on each other. After a layer is done, all
+ * threads wait at a barrier, then the links of this layer are copied and
+ * the threads wait again before the next layer is started. The links are
+ * copied in groups by the linked node, so two nodes linked to the same
+ * input are copied by one thread, in plan order.
+ *
+ * Every node runs as in Cells_run_plan: fused chains at their last node,
+ * groups at their first node, with the weights prefetch of the slab. It is
+ * a whole run like Cells_run_plan, all nodes run and the dirty flags are
+ * cleared. Only the links to nodes of the same layer differ, see above.
+ *
+ * Cells_run_cells_threads runs whole cells as tasks. Links are only inside
+ * a cell, so the cells are independent. Every thread gets a range of the
+ * cells in its own deque and takes them from the top. A thread without
+ * cells steals the bottom half of the fullest deque of the other threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cells-internal.h"
+
+#define POOL_SPIN 4096			// barrier spins before sched_yield ()
+#define POOL_CACHE_LINE 64
+
+struct pool_deque
+{
+	atomic_flag lock;
+	S8 top;						// next task of the owner thread
+	S8 bottom;					// end of tasks, other threads steal from here
+} __attribute__ ((aligned (POOL_CACHE_LINE)));
+
+struct pool
+{
+	S8 threads_max;				// with the calling thread
+	pthread_t *threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_start;
+	pthread_cond_t cond_done;
+	S8 generation;
+	S8 busy;
+	U1 quit;
+	pool_job job;
+	void *arg;
+	struct pool_deque *deques;
+
+	// barrier and work counter for the running job:
+	atomic_llong barrier_count;
+	atomic_int barrier_sense;
+	atomic_llong next;
+	atomic_int error;
+};
+
+struct pool_worker
+{
+	struct pool *pool;
+	S8 thread;
+};
+
+static void *pool_worker_main (void *arg)
+{
+	struct pool_worker *worker = arg;
+	struct pool *pool = worker->pool;
+	S8 thread = worker->thread;
+	S8 generation = 0;
+
+	cells_free (worker);
+
+	while (1)
+	{
+		pthread_mutex_lock (&pool->mutex);
+		while (pool->quit == FALSE && pool->generation == generation)
+		{
+			pthread_cond_wait (&pool->cond_start, &pool->mutex);
+		}
+		if (pool->quit == TRUE)
+		{
+			pthread_mutex_unlock (&pool->mutex);
+			break;
+		}
+		generation = pool->generation;
+		pthread_mutex_unlock (&pool->mutex);
+
+		pool->job (pool, thread, pool->arg);
+
+		pthread_mutex_lock (&pool->mutex);
+		pool->busy--;
+		if (pool->busy == 0)
+		{
+			pthread_cond_signal (&pool->cond_done);
+		}
+		pthread_mutex_unlock (&pool->mutex);
+	}
+	return (NULL);
+}
+
+struct pool *Cells_pool_create (S8 threads)
+{
+	// threads: number of threads with the calling thread, 0 = all online CPUs
+	struct pool *pool;
+	struct pool_worker *worker;
+	S8 i;
+
+	if (threads <= 0)
+	{
+		threads = sysconf (_SC_NPROCESSORS_ONLN);
+		if (threads <= 0)
+		{
+			threads = 1;
+		}
+	}
+
+	pool = (struct pool *) cells_calloc (1, sizeof (struct pool));
+	if (pool == NULL)
+	{
+		printf ("pool_create: ERROR: can't allocate pool!\n");
+		return (NULL);
+	}
+
+	pool->threads_max = threads;
+	pool->threads = (pthread_t *) cells_calloc (threads, sizeof (pthread_t));
+	if (pool->threads == NULL)
+	{
+		printf ("pool_create: ERROR: can't allocate %lli threads!\n", threads);
+		cells_free (pool);
+		return (NULL);
+	}
+
+	pool->deques = (struct pool_deque *) cells_aligned_alloc (threads * sizeof (struct pool_deque));
+	if (pool->deques == NULL)
+	{
+		printf ("pool_create: ERROR: can't allocate %lli deques!\n", threads);
+		cells_free (pool->threads);
+		cells_free (pool);
+		return (NULL);
+	}
+	for (i = 0; i < threads; i++)
+	{
+		atomic_flag_clear (&pool->deques[i].lock);
+		pool->deques[i].top = 0;
+		pool->deques[i].bottom = 0;
+	}
+
+	pthread_mutex_init (&pool->mutex, NULL);
+	pthread_cond_init (&pool->cond_start, NULL);
+	pthread_cond_init (&pool->cond_done, NULL);
+	atomic_init (&pool->barrier_count, threads);
+	atomic_init (&pool->barrier_sense, 0);
+	atomic_init (&pool->next, 0);
+	atomic_init (&pool->error, 0);
+
+	// thread 0 is the caller of pool_run
+	for (i = 1; i < threads; i++)
+	{
+		worker = (struct pool_worker *) cells_calloc (1, sizeof (struct pool_worker));
+		if (worker == NULL)
+		{
+			printf ("pool_create: ERROR: can't allocate worker!\n");
+			pool->threads_max = i;
+			Cells_pool_free (pool);
+			return (NULL);
+		}
+		worker->pool = pool;
+		worker->thread = i;
+
+		if (pthread_create (&pool->threads[i], NULL, pool_worker_main, worker) != 0)
+		{
+			printf ("pool_create: ERROR: can't start thread %lli!\n", i);
+			cells_free (worker);
+			pool->threads_max = i;
+			Cells_pool_free (pool);
+			return (NULL);
+		}
+	}
+	return (pool);
+}
+
+S2 Cells_pool_free (struct pool *pool)
+{
+	S8 i;
+
+	if (pool == NULL)
+	{
+		printf ("pool_free: ERROR: pool not allocated!\n");
+		return (1);
+	}
+
+	pthread_mutex_lock (&pool->mutex);
+	pool->quit = TRUE;
+	pthread_cond_broadcast (&pool->cond_start);
+	pthread_mutex_unlock (&pool->mutex);
+
+	for (i = 1; i < pool->threads_max; i++)
+	{
+		pthread_join (pool->threads[i], NULL);
+	}
+
+	pthread_mutex_destroy (&pool->mutex);
+	pthread_cond_destroy (&pool->cond_start);
+	pthread_cond_destroy (&pool->cond_done);
+	cells_free (pool->deques);
+	cells_free (pool->threads);
+	cells_free (pool);
+	return (0);
+}
+
+S8 pool_threads (struct pool *pool)
+{
+	return (pool->threads_max);
+}
+
+S2 pool_run (struct pool *pool, pool_job job, void *arg)
+{
+	// run job on all threads, returns when all threads are done
+	atomic_store (&pool->next, 0);
+	atomic_store (&pool->error, 0);
+
+	pthread_mutex_lock (&pool->mutex);
+	pool->job = job;
+	pool->arg = arg;
+	pool->busy = pool->threads_max - 1;
+	pool->generation++;
+	pthread_cond_broadcast (&pool->cond_start);
+	pthread_mutex_unlock (&pool->mutex);
+
+	job (pool, 0, arg);
+
+	pthread_mutex_lock (&pool->mutex);
+	while (pool->busy > 0)
+	{
+		pthread_cond_wait (&pool->cond_done, &pool->mutex);
+	}
+	pthread_mutex_unlock (&pool->mutex);
+
+	return (atomic_load (&pool->error));
+}
+
+void pool_barrier (struct pool *pool, int *sense)
+{
+	// sense reversing barrier, the last thread resets the work counter
+	S8 spin = 0;
+
+	*sense = !*sense;
+	if (atomic_fetch_sub (&pool->barrier_count, 1) == 1)
+	{
+		atomic_store (&pool->barrier_count, pool->threads_max);
+		atomic_store (&pool->next, 0);
+		atomic_store (&pool->barrier_sense, *sense);
+		return;
+	}
+
+	while (atomic_load (&pool->barrier_sense) != *sense)
+	{
+		spin++;
+		if (spin > POOL_SPIN)
+		{
+			sched_yield ();
+		}
+	}
+}
+
+S8 pool_next (struct pool *pool, S8 chunk)
+{
+	// get next work index of the running job
+	return (atomic_fetch_add (&pool->next, chunk));
+}
+
+void pool_error (struct pool *pool)
+{
+	atomic_store (&pool->error, 1);
+}
+
+S2 pool_failed (struct pool *pool)
+{
+	return (atomic_load (&pool->error));
+}
+
+int pool_sense (struct pool *pool)
+{
+	return (atomic_load (&pool->barrier_sense));
+}
+
+
+// threaded plan run:
+
+struct plan_job
+{
+	struct cell *cells;
+	S8 start_cell;
+	S8 end_cell;
+	S8 start_layer;
+	S8 end_layer;
+};
+
+static S8 plan_job_chunk (struct pool *pool, S8 entries)
+{
+	S8 chunk;
+
+	chunk = entries / (pool->threads_max * 8);
+	if (chunk < 1)
+	{
+		chunk = 1;
+	}
+	return (chunk);
+}
+
+static void plan_job_run (struct pool *pool, S8 thread, void *arg)
+{
+	struct plan_job *job = arg;
+	struct plan *plan;
+	struct plan_layer *layer;
+	S8 i, l, e, start, end, chunk;
+	int sense;
+
+	sense = pool_sense (pool);
+
+	for (i = job->start_cell; i <= job->end_cell; i++)
+	{
+		plan = job->cells[i].plan;
+
+		for (l = 0; l < plan->layers_max; l++)
+		{
+			layer = &plan->layers[l];
+			if (layer->layer < job->start_layer)
+			{
+				continue;
+			}
+			if (layer->layer > job->end_layer)
+			{
+				break;
+			}
+
+			chunk = plan_job_chunk (pool, layer->entry_end - layer->entry_start);
+
+			// run the nodes of this layer
+			while (pool_failed (pool) == 0)
+			{
+				start = layer->entry_start + pool_next (pool, chunk);
+				if (start >= layer->entry_end)
+				{
+					break;
+				}
+				end = start + chunk;
+				if (end > layer->entry_end)
+				{
+					end = layer->entry_end;
+				}
+
+				for (e = start; e < end; e++)
+				{
+					if (plan_run_node (plan, e, job->start_layer, job->end_layer) != 0)
+					{
+						printf ("run_plan_threads: error running ANN!\n");
+						pool_error (pool);
+						break;
+					}
+				}
+			}
+			pool_barrier (pool, &sense);
+
+			// layer done: copy the links, grouped by the linked node
+			chunk = plan_job_chunk (pool, layer->group_end - layer->group_start);
+			while (pool_failed (pool) == 0)
+			{
+				start = layer->group_start + pool_next (pool, chunk);
+				if (start >= layer->group_end)
+				{
+					break;
+				}
+				end = start + chunk;
+				if (end > layer->group_end)
+				{
+					end = layer->group_end;
+				}
+
+				for (e = start; e < end; e++)
+				{
+					plan_pull_links (plan, e, job->start_layer, job->end_layer);
+				}
+			}
+			pool_barrier (pool, &sense);
+		}
+	}
+}
+
+S2 Cells_run_plan_threads (struct cell *cells, struct pool *pool, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
+{
+	struct plan_job job;
+	S8 i;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_plan_threads: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (pool == NULL)
+	{
+		printf ("run_plan_threads: ERROR: pool not allocated!\n");
+		return (1);
+	}
+
+	// the plans are compiled here, before the threads are started
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (plan_check (cells, i) != 0)
+		{
+			printf ("run_plan_threads: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+	}
+
+	job.cells = cells;
+	job.start_cell = start_cell;
+	job.end_cell = end_cell;
+	job.start_layer = start_layer;
+	job.end_layer = end_layer;
+
+	if (pool_run (pool, plan_job_run, &job) != 0)
+	{
+		printf ("run_plan_threads: error running cells!\n");
+		return (1);
+	}
+	return (0);
+}
+
+
+// work stealing cells run:
+
+static void deque_lock (struct pool_deque *deque)
+{
+	while (atomic_flag_test_and_set_explicit (&deque->lock, memory_order_acquire))
+	{
+		sched_yield ();
+	}
+}
+
+static void deque_unlock (struct pool_deque *deque)
+{
+	atomic_flag_clear_explicit (&deque->lock, memory_order_release);
+}
+
+static S8 deque_pop (struct pool *pool, S8 thread)
+{
+	struct pool_deque *deque = &pool->deques[thread];
+	S8 task = -1;
+
+	deque_lock (deque);
+	if (deque->top < deque->bottom)
+	{
+		task = deque->top;
+		deque->top++;
+	}
+	deque_unlock (deque);
+	return (task);
+}
+
+static S8 deque_steal (struct pool *pool, S8 thread)
+{
+	struct pool_deque *victim;
+	S8 i, v, size, size_max, steal_top, steal_bottom;
+
+	while (1)
+	{
+		// find the fullest deque
+		v = -1;
+		size_max = 0;
+		for (i = 1; i < pool->threads_max; i++)
+		{
+			victim = &pool->deques[(thread + i) % pool->threads_max];
+			deque_lock (victim);
+			size = victim->bottom - victim->top;
+			deque_unlock (victim);
+
+			if (size > size_max)
+			{
+				size_max = size;
+				v = (thread + i) % pool->threads_max;
+			}
+		}
+
+		if (v < 0)
+		{
+			// no tasks left
+			return (-1);
+		}
+
+		victim = &pool->deques[v];
+		deque_lock (victim);
+		size = victim->bottom - victim->top;
+		if (size <= 0)
+		{
+			// got empty meanwhile, try again
+			deque_unlock (victim);
+			continue;
+		}
+
+		steal_bottom = victim->bottom;
+		steal_top = victim->bottom - (size + 1) / 2;
+		victim->bottom = steal_top;
+		deque_unlock (victim);
+
+		if (steal_bottom - steal_top > 1)
+		{
+			deque_lock (&pool->deques[thread]);
+			pool->deques[thread].top = steal_top + 1;
+			pool->deques[thread].bottom = steal_bottom;
+			deque_unlock (&pool->deques[thread]);
+		}
+		return (steal_top);
+	}
+}
+
+static void cells_job_run (struct pool *pool, S8 thread, void *arg)
+{
+	struct plan_job *job = arg;
+	S8 cell;
+
+	while (pool_failed (pool) == 0)
+	{
+		cell = deque_pop (pool, thread);
+		if (cell < 0)
+		{
+			cell = deque_steal (pool, thread);
+			if (cell < 0)
+			{
+				break;
+			}
+		}
+
+		if (plan_run_cell (job->cells, cell, job->start_layer, job->end_layer) != 0)
+		{
+			printf ("run_cells_threads: error running cell: %lli!\n", cell);
+			pool_error (pool);
+		}
+	}
+}
+
+S2 Cells_run_cells_threads (struct cell *cells, struct pool *pool, S8 start_cell, S8 end_cell, S8 start_layer, S8 end_layer)
+{
+	struct plan_job job;
+	S8 i, cells_max;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("run_cells_threads: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (pool == NULL)
+	{
+		printf ("run_cells_threads: ERROR: pool not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		if (plan_check (cells, i) != 0)
+		{
+			printf ("run_cells_threads: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+	}
+
+	// give every thread an equal range of cells
+	cells_max = end_cell + 1 - start_cell;
+	for (i = 0; i < pool->threads_max; i++)
+	{
+		pool->deques[i].top = start_cell + (cells_max * i) / pool->threads_max;
+		pool->deques[i].bottom = start_cell + (cells_max * (i + 1)) / pool->threads_max;
+	}
+
+	job.cells = cells;
+	job.start_cell = start_cell;
+	job.end_cell = end_cell;
+	job.start_layer = start_layer;
+	job.end_layer = end_layer;
+
+	if (pool_run (pool, cells_job_run, &job) != 0)
+	{
+		printf ("run_cells_threads: error running cells!\n");
+		return (1);
+	}
+	return (0);
+}
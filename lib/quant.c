@@ -0,0 +1,686 @@
+/*
+ * This file quant.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Int8 kernel:
+ * The layers of a native kernel can run with int8 weights and inputs, the
+ * dot products are added up as S4 and scaled back to float. A node needs a
+ * calibration first, to find the range of the values of every layer:
+ *
+ * Cells_quant_start (cells, start_cell, end_cell, samples_max): the kernel
+ *   nodes record their input vectors (the first samples_max) and the range
+ *   of their inputs on every run.
+ * Run a representative dataset, with Cells_fann_run_ann_go_links or any
+ *   other run function.
+ * Cells_quant_finish (cells, start_cell, end_cell): the recorded inputs are
+ *   run through the float layers to get the ranges of the hidden layers, and
+ *   the int8 weights are made. From now on the nodes run with int8.
+ *
+ * Scales: the inputs of a layer are x / x_scale, x_scale = max |x| / 127.
+ * Every neuron (row) has its own weight scale: max |w| / 127. The bias
+ * weight stays float. Values out of the calibrated range are clipped.
+ *
+ * Cells_quant_report compares the int8 and float outputs of every node for
+ * the recorded inputs. Cells_quant_clear switches back to float. A new
+ * kernel (Cells_set_kernel, Cells_set_fast_math, Cells_fann_read_ann) has
+ * no int8 layers, it must be calibrated again. Nodes with 16 bit weights
+ * (Cells_set_node_weights) are not quantized.
+ *
+ * The dot products use AVX2 if the kernel instruction set is AVX2 or above,
+ * else C code. The float weights are kept for the report.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUANT_X86 1
+#endif
+
+#include "cells-internal.h"
+
+#define QUANT_PAD 32			// row padding: one AVX2 vector of bytes
+#define QUANT_MAX 127
+
+#define QUANT_CALIBRATE 0		// quant states
+#define QUANT_INT8 1
+
+struct quant_layer
+{
+	S8 inputs;
+	S8 outputs;
+	S8 cols;				// inputs, padded to QUANT_PAD
+	S1 *weights;			// rows of cols
+	fann_type *scale;		// per row: weight scale * input scale
+	fann_type *bias;		// per row
+	fann_type x_scale;		// input scale
+};
+
+struct quant
+{
+	U1 state;
+	S8 layers_max;
+	struct quant_layer *layers;
+	fann_type *range;		// per layer: max |x| of the inputs
+	S8 samples_max;
+	S8 samples;
+	fann_type *sample;		// recorded node inputs
+	S8 cols_max;
+	S1 *xq;					// int8 layer inputs
+	S4 *acc;
+	fann_type *x;
+	fann_type *sums;
+	U1 clone;				// TRUE: the layers belong to another quant, see quant_clone
+};
+
+void quant_free (struct quant *quant)
+{
+	S8 l;
+
+	if (quant->layers && quant->clone == FALSE)
+	{
+		for (l = 0; l < quant->layers_max; l++)
+		{
+			if (quant->layers[l].weights) cells_free (quant->layers[l].weights);
+			if (quant->layers[l].scale) cells_free (quant->layers[l].scale);
+			if (quant->layers[l].bias) cells_free (quant->layers[l].bias);
+		}
+		cells_free (quant->layers);
+	}
+	if (quant->range && quant->clone == FALSE) cells_free (quant->range);
+	if (quant->sample) cells_free (quant->sample);
+	if (quant->xq) cells_free (quant->xq);
+	if (quant->acc) cells_free (quant->acc);
+	if (quant->x) cells_free (quant->x);
+	if (quant->sums) cells_free (quant->sums);
+	cells_free (quant);
+}
+
+static struct quant *quant_create (struct kernel *kernel, S8 samples_max)
+{
+	// calibration state: buffers for the recorded inputs and the ranges
+	struct quant *quant;
+	fann_type *weights;
+	S8 l, inputs, outputs, cols, width = 0;
+
+	quant = (struct quant *) cells_calloc (1, sizeof (struct quant));
+	if (quant == NULL)
+	{
+		return (NULL);
+	}
+
+	quant->layers_max = kernel_layers (kernel);
+	quant->samples_max = samples_max;
+
+	for (l = 0; l < quant->layers_max; l++)
+	{
+		kernel_layer_get (kernel, l, &inputs, &outputs, &cols, &weights);
+		if (cols > width) width = cols;
+		if (outputs > width) width = outputs;
+	}
+	kernel_layer_get (kernel, 0, &inputs, &outputs, &cols, &weights);
+	quant->cols_max = (width + QUANT_PAD - 1) / QUANT_PAD * QUANT_PAD;
+
+	quant->layers = (struct quant_layer *) cells_calloc (quant->layers_max, sizeof (struct quant_layer));
+	quant->range = (fann_type *) cells_calloc (quant->layers_max, sizeof (fann_type));
+	quant->sample = (fann_type *) cells_calloc (samples_max * inputs + 1, sizeof (fann_type));
+	quant->xq = (S1 *) cells_aligned_alloc (quant->cols_max);
+	quant->acc = (S4 *) cells_calloc (quant->cols_max, sizeof (S4));
+	quant->x = (fann_type *) cells_aligned_alloc (quant->cols_max * sizeof (fann_type));
+	quant->sums = (fann_type *) cells_aligned_alloc (quant->cols_max * sizeof (fann_type));
+	if (quant->layers == NULL || quant->range == NULL || quant->sample == NULL || quant->xq == NULL
+		|| quant->acc == NULL || quant->x == NULL || quant->sums == NULL)
+	{
+		quant_free (quant);
+		return (NULL);
+	}
+	return (quant);
+}
+
+S2 quant_clone (struct quant *quant, struct quant **clone_ret)
+{
+	// int8 layers for a run context: own run buffers, NULL while calibrating: the float layers run
+	struct quant *clone;
+
+	*clone_ret = NULL;
+	if (quant->state == QUANT_CALIBRATE)
+	{
+		return (0);
+	}
+
+	clone = (struct quant *) cells_calloc (1, sizeof (struct quant));
+	if (clone == NULL)
+	{
+		return (1);
+	}
+
+	*clone = *quant;
+	clone->clone = TRUE;
+	clone->samples_max = 0;
+	clone->samples = 0;
+	clone->sample = NULL;
+	clone->xq = (S1 *) cells_aligned_alloc (quant->cols_max);
+	clone->acc = (S4 *) cells_calloc (quant->cols_max, sizeof (S4));
+	clone->x = (fann_type *) cells_aligned_alloc (quant->cols_max * sizeof (fann_type));
+	clone->sums = (fann_type *) cells_aligned_alloc (quant->cols_max * sizeof (fann_type));
+	if (clone->xq == NULL || clone->acc == NULL || clone->x == NULL || clone->sums == NULL)
+	{
+		quant_free (clone);
+		return (1);
+	}
+
+	*clone_ret = clone;
+	return (0);
+}
+
+static void quant_record (struct quant *quant, struct kernel *kernel, fann_type *input)
+{
+	// calibration: range of the inputs, and the first samples_max inputs
+	fann_type value;
+	S8 inputs, outputs, cols, i;
+	fann_type *weights;
+
+	kernel_layer_get (kernel, 0, &inputs, &outputs, &cols, &weights);
+	for (i = 0; i < inputs; i++)
+	{
+		value = input[i] < 0 ? -input[i] : input[i];
+		if (value > quant->range[0])
+		{
+			quant->range[0] = value;
+		}
+	}
+
+	if (quant->samples < quant->samples_max)
+	{
+		memcpy (&quant->sample[quant->samples * inputs], input, inputs * sizeof (fann_type));
+		quant->samples++;
+	}
+}
+
+static void quant_ranges (struct quant *quant, struct kernel *kernel)
+{
+	// ranges of the hidden layers: the recorded inputs through the float layers
+	fann_type *weights;
+	fann_type *x;
+	fann_type value;
+	S8 inputs, outputs, cols;
+	S8 s, l, r, c;
+
+	x = quant->x;
+	for (s = 0; s < quant->samples; s++)
+	{
+		kernel_layer_get (kernel, 0, &inputs, &outputs, &cols, &weights);
+		memcpy (x, &quant->sample[s * inputs], inputs * sizeof (fann_type));
+
+		for (l = 0; l < quant->layers_max; l++)
+		{
+			kernel_layer_get (kernel, l, &inputs, &outputs, &cols, &weights);
+			for (c = 0; c < inputs; c++)
+			{
+				value = x[c] < 0 ? -x[c] : x[c];
+				if (value > quant->range[l])
+				{
+					quant->range[l] = value;
+				}
+			}
+
+			for (r = 0; r < outputs; r++)
+			{
+				quant->sums[r] = weights[r * cols + inputs];
+				for (c = 0; c < inputs; c++)
+				{
+					quant->sums[r] += weights[r * cols + c] * x[c];
+				}
+			}
+			kernel_activate (kernel, l, quant->sums, x);
+		}
+	}
+}
+
+static S2 quant_weights (struct quant *quant, struct kernel *kernel)
+{
+	// int8 weights with a scale per row
+	struct quant_layer *layer;
+	fann_type *weights;
+	fann_type max, value, w_scale;
+	S8 inputs, outputs, cols;
+	S8 l, r, c;
+
+	for (l = 0; l < quant->layers_max; l++)
+	{
+		layer = &quant->layers[l];
+		kernel_layer_get (kernel, l, &inputs, &outputs, &cols, &weights);
+
+		layer->inputs = inputs;
+		layer->outputs = outputs;
+		layer->cols = (inputs + QUANT_PAD - 1) / QUANT_PAD * QUANT_PAD;
+		layer->weights = (S1 *) cells_aligned_alloc (outputs * layer->cols);
+		layer->scale = (fann_type *) cells_calloc (outputs, sizeof (fann_type));
+		layer->bias = (fann_type *) cells_calloc (outputs, sizeof (fann_type));
+		if (layer->weights == NULL || layer->scale == NULL || layer->bias == NULL)
+		{
+			return (1);
+		}
+
+		// a layer which only got zero inputs: any scale
+		layer->x_scale = quant->range[l] > 0 ? quant->range[l] / QUANT_MAX : 1;
+
+		for (r = 0; r < outputs; r++)
+		{
+			max = 0;
+			for (c = 0; c < inputs; c++)
+			{
+				value = weights[r * cols + c] < 0 ? -weights[r * cols + c] : weights[r * cols + c];
+				if (value > max) max = value;
+			}
+			w_scale = max > 0 ? max / QUANT_MAX : 1;
+
+			for (c = 0; c < inputs; c++)
+			{
+				layer->weights[r * layer->cols + c] = (S1) lrintf (weights[r * cols + c] / w_scale);
+			}
+			layer->scale[r] = w_scale * layer->x_scale;
+			layer->bias[r] = weights[r * cols + inputs];
+		}
+	}
+	return (0);
+}
+
+
+// dot products:
+
+static void quant_rows_scalar (const S1 *weights, const S1 *x, S8 rows, S8 cols, S4 *acc)
+{
+	S8 r, c;
+	S4 sum;
+
+	for (r = 0; r < rows; r++)
+	{
+		sum = 0;
+		for (c = 0; c < cols; c++)
+		{
+			sum += weights[c] * x[c];
+		}
+		acc[r] = sum;
+		weights += cols;
+	}
+}
+
+#if defined(QUANT_X86)
+__attribute__ ((target ("avx2")))
+static inline __m256i quant_dot_avx2 (__m256i sum, __m256i x_abs, __m256i x, const S1 *weights)
+{
+	// maddubs needs unsigned * signed: |x| * (w with the sign of x)
+	__m256i w;
+
+	w = _mm256_load_si256 ((const __m256i *) weights);
+	w = _mm256_maddubs_epi16 (x_abs, _mm256_sign_epi8 (w, x));
+	return (_mm256_add_epi32 (sum, _mm256_madd_epi16 (w, _mm256_set1_epi16 (1))));
+}
+
+__attribute__ ((target ("avx2")))
+static void quant_rows_avx2 (const S1 *weights, const S1 *x, S8 rows, S8 cols, S4 *acc)
+{
+	// four rows at once: four independent sums, one horizontal add
+	__m256i sum0, sum1, sum2, sum3, xv, x_abs;
+	__m128i low;
+	S8 r, c;
+
+	for (r = 0; r + 4 <= rows; r += 4)
+	{
+		sum0 = _mm256_setzero_si256 ();
+		sum1 = _mm256_setzero_si256 ();
+		sum2 = _mm256_setzero_si256 ();
+		sum3 = _mm256_setzero_si256 ();
+		for (c = 0; c < cols; c += QUANT_PAD)
+		{
+			xv = _mm256_load_si256 ((const __m256i *) &x[c]);
+			x_abs = _mm256_abs_epi8 (xv);
+			sum0 = quant_dot_avx2 (sum0, x_abs, xv, &weights[c]);
+			sum1 = quant_dot_avx2 (sum1, x_abs, xv, &weights[cols + c]);
+			sum2 = quant_dot_avx2 (sum2, x_abs, xv, &weights[2 * cols + c]);
+			sum3 = quant_dot_avx2 (sum3, x_abs, xv, &weights[3 * cols + c]);
+		}
+
+		sum0 = _mm256_hadd_epi32 (_mm256_hadd_epi32 (sum0, sum1), _mm256_hadd_epi32 (sum2, sum3));
+		low = _mm_add_epi32 (_mm256_castsi256_si128 (sum0), _mm256_extracti128_si256 (sum0, 1));
+		_mm_storeu_si128 ((__m128i *) &acc[r], low);
+		weights += 4 * cols;
+	}
+
+	for (; r < rows; r++)
+	{
+		sum0 = _mm256_setzero_si256 ();
+		for (c = 0; c < cols; c += QUANT_PAD)
+		{
+			xv = _mm256_load_si256 ((const __m256i *) &x[c]);
+			sum0 = quant_dot_avx2 (sum0, _mm256_abs_epi8 (xv), xv, &weights[c]);
+		}
+
+		low = _mm_add_epi32 (_mm256_castsi256_si128 (sum0), _mm256_extracti128_si256 (sum0, 1));
+		low = _mm_add_epi32 (low, _mm_shuffle_epi32 (low, 0x4e));
+		low = _mm_add_epi32 (low, _mm_shuffle_epi32 (low, 0xb1));
+		acc[r] = _mm_cvtsi128_si32 (low);
+		weights += cols;
+	}
+}
+
+__attribute__ ((target ("avx2")))
+static void quant_inputs_avx2 (const fann_type *x, S1 *xq, S8 inputs, fann_type x_inv)
+{
+	// 8 values at once: scale, clip, round and pack to bytes
+	__m256 scale, max, min, v;
+	__m256i q, gather;
+	S8 i;
+
+	scale = _mm256_set1_ps (x_inv);
+	max = _mm256_set1_ps (QUANT_MAX);
+	min = _mm256_set1_ps (-QUANT_MAX);
+	gather = _mm256_setr_epi32 (0, 4, 0, 4, 0, 4, 0, 4);
+
+	for (i = 0; i + 8 <= inputs; i += 8)
+	{
+		v = _mm256_mul_ps (_mm256_loadu_ps (&x[i]), scale);
+		v = _mm256_max_ps (_mm256_min_ps (v, max), min);
+		q = _mm256_cvtps_epi32 (v);
+		q = _mm256_packs_epi32 (q, q);
+		q = _mm256_packs_epi16 (q, q);
+		q = _mm256_permutevar8x32_epi32 (q, gather);
+		_mm_storel_epi64 ((__m128i *) &xq[i], _mm256_castsi256_si128 (q));
+	}
+	for (; i < inputs; i++)
+	{
+		xq[i] = (S1) lrintf (fminf (fmaxf (x[i] * x_inv, -QUANT_MAX), QUANT_MAX));
+	}
+}
+#endif
+
+static void quant_inputs_scalar (const fann_type *x, S1 *xq, S8 inputs, fann_type x_inv)
+{
+	// round to nearest even, as the AVX2 code
+	S8 i;
+
+	for (i = 0; i < inputs; i++)
+	{
+		xq[i] = (S1) lrintf (fminf (fmaxf (x[i] * x_inv, -QUANT_MAX), QUANT_MAX));
+	}
+}
+
+fann_type *quant_run (struct quant *quant, struct kernel *kernel, fann_type *input)
+{
+	// int8 run, NULL while calibrating: the caller runs the float layers
+	struct quant_layer *layer;
+	const fann_type *x;
+	fann_type x_inv;
+	U1 avx2;
+	S8 l, i;
+
+	if (quant->state == QUANT_CALIBRATE)
+	{
+		quant_record (quant, kernel, input);
+		return (NULL);
+	}
+
+	avx2 = Cells_kernel_isa () >= KERNEL_ISA_AVX2;
+
+	x = input;
+	for (l = 0; l < quant->layers_max; l++)
+	{
+		layer = &quant->layers[l];
+
+		x_inv = 1 / layer->x_scale;
+		for (i = layer->inputs; i < layer->cols; i++)
+		{
+			quant->xq[i] = 0;
+		}
+
+#if defined(QUANT_X86)
+		if (avx2 == TRUE)
+		{
+			quant_inputs_avx2 (x, quant->xq, layer->inputs, x_inv);
+			quant_rows_avx2 (layer->weights, quant->xq, layer->outputs, layer->cols, quant->acc);
+		}
+		else
+#endif
+		{
+			quant_inputs_scalar (x, quant->xq, layer->inputs, x_inv);
+			quant_rows_scalar (layer->weights, quant->xq, layer->outputs, layer->cols, quant->acc);
+		}
+
+		for (i = 0; i < layer->outputs; i++)
+		{
+			quant->sums[i] = quant->acc[i] * layer->scale[i] + layer->bias[i];
+		}
+		kernel_activate (kernel, l, quant->sums, quant->x);
+		x = quant->x;
+	}
+	return (quant->x);
+}
+
+
+S2 Cells_quant_start (struct cell *cells, S8 start_cell, S8 end_cell, S8 samples_max)
+{
+	// start the calibration of the kernel nodes, samples_max: recorded inputs per node
+	struct quant *quant;
+	struct neuron *neuron;
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("quant_start: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (samples_max <= 0)
+	{
+		printf ("quant_start: error: samples_max must be greater than zero!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			neuron = &cells[i].neurons[n];
+			if (neuron->kernel == NULL)
+			{
+				continue;
+			}
+
+			if (kernel_weights (neuron->kernel) != WEIGHTS_F32)
+			{
+				printf ("quant_start: node has 16 bit weights, stays as it is: cell: %lli, node: %lli\n", i, n);
+				continue;
+			}
+
+			if (kernel_sparse (neuron->kernel) == TRUE)
+			{
+				printf ("quant_start: node has sparse layers, stays as it is: cell: %lli, node: %lli\n", i, n);
+				continue;
+			}
+
+			quant = quant_create (neuron->kernel, samples_max);
+			if (quant == NULL)
+			{
+				printf ("quant_start: out of memory, allocating calibration: cell: %lli, node: %lli!\n", i, n);
+				return (1);
+			}
+			kernel_set_quant (neuron->kernel, quant);
+			memo_flush (neuron->memo);
+		}
+
+		// nodes with int8 layers are not fused
+		cells[i].topology++;
+	}
+	return (0);
+}
+
+S2 Cells_quant_finish (struct cell *cells, S8 start_cell, S8 end_cell)
+{
+	// end the calibration: make the int8 weights, the nodes run with int8 now
+	struct quant *quant;
+	struct neuron *neuron;
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("quant_finish: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			neuron = &cells[i].neurons[n];
+			if (neuron->kernel == NULL)
+			{
+				continue;
+			}
+
+			quant = kernel_get_quant (neuron->kernel);
+			if (quant == NULL || quant->state != QUANT_CALIBRATE)
+			{
+				continue;
+			}
+
+			if (quant->samples == 0)
+			{
+				printf ("quant_finish: node was not run, stays float: cell: %lli, node: %lli\n", i, n);
+				kernel_set_quant (neuron->kernel, NULL);
+				continue;
+			}
+
+			quant_ranges (quant, neuron->kernel);
+			if (quant_weights (quant, neuron->kernel) != 0)
+			{
+				printf ("quant_finish: out of memory, allocating int8 weights: cell: %lli, node: %lli!\n", i, n);
+				kernel_set_quant (neuron->kernel, NULL);
+				return (1);
+			}
+			quant->state = QUANT_INT8;
+			memo_flush (neuron->memo);
+		}
+	}
+	return (0);
+}
+
+S2 Cells_quant_clear (struct cell *cells, S8 start_cell, S8 end_cell)
+{
+	// back to the float layers
+	S8 i, n;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("quant_clear: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			if (cells[i].neurons[n].kernel != NULL && kernel_get_quant (cells[i].neurons[n].kernel) != NULL)
+			{
+				kernel_set_quant (cells[i].neurons[n].kernel, NULL);
+				memo_flush (cells[i].neurons[n].memo);
+			}
+		}
+		cells[i].topology++;
+	}
+	return (0);
+}
+
+S2 Cells_quant_report (struct cell *cells, S8 start_cell, S8 end_cell, F8 *max_error)
+{
+	// int8 against float outputs of every int8 node, for its recorded inputs
+	struct quant *quant;
+	struct neuron *neuron;
+	fann_type *weights;
+	fann_type *output;
+	fann_type *output_float;
+	F8 error, node_max, node_sum;
+	S8 inputs, outputs, cols, last_inputs;
+	S8 i, n, s, o, nodes = 0;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("quant_report: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	*max_error = 0.0;
+	for (i = start_cell; i <= end_cell; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			neuron = &cells[i].neurons[n];
+			if (neuron->kernel == NULL)
+			{
+				continue;
+			}
+
+			quant = kernel_get_quant (neuron->kernel);
+			if (quant == NULL || quant->state != QUANT_INT8)
+			{
+				continue;
+			}
+
+			kernel_layer_get (neuron->kernel, 0, &inputs, &outputs, &cols, &weights);
+			kernel_layer_get (neuron->kernel, quant->layers_max - 1, &last_inputs, &outputs, &cols, &weights);
+
+			node_max = 0.0;
+			node_sum = 0.0;
+			for (s = 0; s < quant->samples; s++)
+			{
+				output = quant_run (quant, neuron->kernel, &quant->sample[s * inputs]);
+				output_float = kernel_run_float (neuron->kernel, &quant->sample[s * inputs]);
+
+				for (o = 0; o < outputs; o++)
+				{
+					error = fabs ((F8) output[o] - (F8) output_float[o]);
+					node_sum += error;
+					if (error > node_max)
+					{
+						node_max = error;
+					}
+				}
+			}
+
+			printf ("quant_report: cell: %lli, node: %lli: samples: %lli, max error %e, mean error %e\n",
+				i, n, quant->samples, node_max, node_sum / (quant->samples * outputs));
+			if (node_max > *max_error)
+			{
+				*max_error = node_max;
+			}
+			nodes++;
+		}
+	}
+
+	printf ("quant_report: %lli int8 nodes: max error %e\n", nodes, *max_error);
+	return (0);
+}
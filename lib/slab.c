@@ -0,0 +1,193 @@
+/*
+ * This file slab.c is part of Cells.
+ *
+ * (c) Copyright Stefan Pietzonke (jay-t@gmx.net), 2020
+ *
+ * Cells is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cells.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Weights slab:
+ * Cells_pack_weights (cells, max_cells, huge) moves the weights of all native
+ * kernels of the graph into one slab, in the order the compiled plans run
+ * them: cell by cell, the kernels of the plan entries, a fused chain at its
+ * last node and a group at its first node. The kernels which don't run in a
+ * whole plan run, the nodes of chains and groups, are put after them.
+ * Every array starts at a cache line, with huge = TRUE the slab is taken from
+ * huge pages if the system has them, see alloc.c.
+ *
+ * The plan has the kernel which runs after each entry, a run prefetches the
+ * start of its weights while the entry runs.
+ *
+ * Pack the weights when the graph is ready: the kernels which are built
+ * again later, by a new plan or a node kernel change, are on the heap. The
+ * FANN networks and the int8 layers are not moved, the weights of tiny
+ * kernels are in the kernel structure already. The old slab is freed by the
+ * next Cells_pack_weights and by Cells_dealloc_neurons.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "cells-internal.h"
+
+void slab_plan (struct plan *plan)
+{
+	// set the kernel which runs after every entry
+	struct kernel *next = NULL;
+	struct kernel *kernel;
+	S8 e;
+
+	for (e = plan->entries_max - 1; e >= 0; e--)
+	{
+		plan->prefetch[e] = next;
+		kernel = fuse_kernel (plan, e);
+		if (kernel != NULL)
+		{
+			next = kernel;
+		}
+	}
+}
+
+static U1 slab_in_plan (struct cell *cells, S8 cell, S8 node)
+{
+	// TRUE: the node kernel is packed in plan order
+	struct plan *plan;
+	S8 e;
+
+	plan = cells[cell].plan;
+	if (plan == NULL)
+	{
+		return (FALSE);
+	}
+
+	e = plan->node_entry[node];
+	if (e < 0 || fuse_kernel (plan, e) != cells[cell].neurons[node].kernel)
+	{
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+static S8 slab_kernels (struct cell *cells, S8 max_cells, struct slab *slab, S8 *full)
+{
+	// bytes of all kernels, slab != NULL: pack them, full: kernels which didn't fit
+	struct plan *plan;
+	struct kernel *kernel;
+	S8 i, e, n, bytes = 0;
+
+	*full = 0;
+
+	for (i = 0; i < max_cells; i++)
+	{
+		plan = cells[i].plan;
+		for (e = 0; plan != NULL && e < plan->entries_max; e++)
+		{
+			kernel = fuse_kernel (plan, e);
+			if (kernel == NULL)
+			{
+				continue;
+			}
+
+			bytes += kernel_slab_bytes (kernel);
+			if (slab != NULL && kernel_slab_pack (kernel, slab) != 0) (*full)++;
+		}
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		for (n = 0; n < cells[i].neurons_max; n++)
+		{
+			kernel = cells[i].neurons[n].kernel;
+			if (kernel == NULL || slab_in_plan (cells, i, n) == TRUE)
+			{
+				continue;
+			}
+
+			bytes += kernel_slab_bytes (kernel);
+			if (slab != NULL && kernel_slab_pack (kernel, slab) != 0) (*full)++;
+		}
+	}
+	return (bytes);
+}
+
+S2 Cells_pack_weights (struct cell *cells, S8 max_cells, U1 huge)
+{
+	// huge: TRUE = slab on huge pages, if there are some
+	struct slab *slab;
+	S8 i, bytes, full;
+
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("pack_weights: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	for (i = 0; i < max_cells; i++)
+	{
+		if (cells[i].neurons != NULL && plan_check (cells, i) != 0)
+		{
+			printf ("pack_weights: error compiling cell: %lli!\n", i);
+			return (1);
+		}
+	}
+
+	bytes = slab_kernels (cells, max_cells, NULL, &full);
+	slab = slab_create (bytes, huge);
+	if (slab == NULL)
+	{
+		printf ("pack_weights: out of memory, allocating slab of %lli bytes!\n", bytes);
+		return (1);
+	}
+	slab_kernels (cells, max_cells, slab, &full);
+
+	if (full > 0)
+	{
+		// the kernels not packed keep their weights, on the heap or in the old slab
+		printf ("pack_weights: error: slab full, %lli kernels not packed!\n", full);
+		slab_keep (slab, cells[0].slab);
+		cells[0].slab = slab;
+		return (1);
+	}
+
+	// no kernel points into the old slab now
+	if (cells[0].slab) slab_free (cells[0].slab);
+	cells[0].slab = slab;
+	return (0);
+}
+
+S2 Cells_slab_info (struct cell *cells, S8 *bytes, U1 *pages)
+{
+	// bytes: packed weights, pages: SLAB_PAGES, SLAB_HUGETLB or SLAB_THP
+	if (cells == NULL)
+	{
+		// error: not allocated memory
+		printf ("slab_info: ERROR: cells structure not allocated!\n");
+		return (1);
+	}
+
+	if (cells[0].slab == NULL)
+	{
+		*bytes = 0;
+		*pages = SLAB_PAGES;
+		return (0);
+	}
+
+	*bytes = slab_bytes (cells[0].slab);
+	*pages = slab_pages (cells[0].slab);
+	return (0);
+}
@@ -22,7 +22,7 @@
 #include <stdarg.h>
 #include <inttypes.h>
 
-#include "cells.h"
+#include "cells-internal.h"
 
 size_t strlen_safe (const char *str, S8 maxlen)
 {
@@ -1,3 +1,4 @@
 #!/bin/bash
 
-clang cells-demo.c -o cells-demo -Wall -g -lfann -lcells -lm
+clang cells-demo.c -o cells-demo -Wall -g -lfann -lcells -lm -lpthread
+clang cells-fast-validate.c -o cells-fast-validate -Wall -g -lfann -lcells -lm -lpthread